@@ -3,6 +3,9 @@
 
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "divsufsort_private.h"
 #include "sssort_imp.hpp"
 #include "trsort_imp.hpp"
@@ -36,7 +39,7 @@ struct SA {
   static SAIDX
   sort_typeBstar(CHARPTR T, SAIDPTR SA,
                  SAIDX *bucket_A, SAIDX *bucket_B,
-                 SAIDX n) {
+                 SAIDX n, int threads) {
     SAIDPTR PAb, ISAb, buf;
 
 #ifdef _OPENMP
@@ -137,6 +140,41 @@ struct SA {
         }
       }
 #else
+      if(1 < threads) {
+      /* Same as the OpenMP variant above: workers claim the next bucket of
+         two leading characters and sort it within their share of the buffer. */
+      std::mutex lock;
+      buf = SA + m, bufsize = (n - (2 * m)) / threads;
+      c0 = ALPHABET_SIZE - 2, c1 = ALPHABET_SIZE - 1, j = m;
+      auto worker = [&](int id) {
+        SAIDPTR curbuf = buf + id * bufsize;
+        SAIDX k = 0, l;
+        saint_t d0, d1;
+        for(;;) {
+          {
+            std::lock_guard<std::mutex> guard(lock);
+            if(0 < (l = j)) {
+              d0 = c0, d1 = c1;
+              do {
+                k = bucket_star(bucket_B, d0, d1);
+                if(--d1 <= d0) {
+                  d1 = ALPHABET_SIZE - 1;
+                  if(--d0 < 0) { break; }
+                }
+              } while(((l - k) <= 1) && (0 < (l = k)));
+              c0 = d0, c1 = d1, j = k;
+            }
+          }
+          if(l == 0) { break; }
+          ss<CHARPTR, SAIDPTR>::sort(T, PAb, SA + k, SA + l,
+                            curbuf, bufsize, (SAIDX)2, n, *(SA + k) == (m - 1));
+        }
+      };
+      std::vector<std::thread> workers;
+      for(int id = 1; id < threads; ++id) { workers.emplace_back(worker, id); }
+      worker(0);
+      for(auto& w : workers) { w.join(); }
+      } else {
       buf = SA + m, bufsize = n - (2 * m);
       for(c0 = ALPHABET_SIZE - 2, j = m; 0 < j; --c0) {
         for(c1 = ALPHABET_SIZE - 1; c0 < c1; j = i, --c1) {
@@ -147,6 +185,7 @@ struct SA {
           }
         }
       }
+      }
 #endif
       } // time_scope
 
@@ -268,7 +307,7 @@ struct SA {
   }
 
   static saint_t
-  create(CHARPTR T, SAIDPTR SA, SAIDX n) {
+  create(CHARPTR T, SAIDPTR SA, SAIDX n, int threads = 1) {
     std::unique_ptr<SAIDX[]> bucket_A, bucket_B;
     SAIDX m;
     saint_t err = 0;
@@ -284,7 +323,7 @@ struct SA {
 
     /* Suffix sort. */
     if(bucket_A && bucket_B) {
-      m = sort_typeBstar(T, SA, bucket_A.get(), bucket_B.get(), n);
+      m = sort_typeBstar(T, SA, bucket_A.get(), bucket_B.get(), n, threads);
       construct_SA(T, SA, bucket_A.get(), bucket_B.get(), n, m);
     } else {
       err = -2;
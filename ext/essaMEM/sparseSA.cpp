@@ -8,6 +8,7 @@
 #include <fstream>
 #include <iomanip>
 #include <stdexcept>
+#include <atomic>
 
 #include <mummer/sparseSA.hpp>
 #include <mummer/sparseSA_imp.hpp>
@@ -17,9 +18,6 @@
 namespace mummer {
 namespace mummer {
 
-// LS suffix sorter (integer alphabet).
-extern "C" { void suffixsort(int *x, int *p, int n, int k, int l); };
-
 // Get maximum query sequence description length.
 static size_t max_len(const std::vector<std::string>& descr) {
   size_t res = 0;
@@ -49,7 +47,12 @@ sparseSA::sparseSA(bounded_string&& S_,
 { }
 
 sparseSA sparseSA::create_auto(const char* S, size_t Slen, int min_len, bool nucleotidesOnly_, int K,
-                               bool off48) {
+                               bool off48, int threads) {
+  return create_auto(bounded_string(S, Slen, K), min_len, nucleotidesOnly_, K, off48, threads);
+}
+
+sparseSA sparseSA::create_auto(bounded_string&& S, int min_len, bool nucleotidesOnly_, int K,
+                               bool off48, int threads) {
   const bool suflink    = K < 4;
   const bool child      = K >= 4;
   int        sparseMult = 1;
@@ -59,42 +62,42 @@ sparseSA sparseSA::create_auto(const char* S, size_t Slen, int min_len, bool nuc
       : (int) std::max((min_len-12)/K,1);
   }
   const int kmer = std::max(0,std::min(10,min_len - sparseMult*K + 1));
-  sparseSA res(S, Slen, true /* 4column */, K, suflink, child, kmer>0, sparseMult,
+  sparseSA res(std::move(S), true /* 4column */, K, suflink, child, kmer>0, sparseMult,
                kmer, nucleotidesOnly_);
-  res.construct(off48);
+  res.construct(off48, threads);
+  return res;
+}
+
+// Suffix sorting needs characters, they are unpacked for the duration
+// of construction. LCP values are computed on the packed words.
+sparseSA sparseSA::create_auto(const packed_text& S, int min_len, bool nucleotidesOnly_, int K, bool off48, int threads) {
+  std::string chars;
+  S.unpack(0, S.size(), chars);
+  bounded_string text(chars.data(), chars.size(), K);
+  text.p_ = &S;
+  sparseSA res(create_auto(std::move(text), min_len, nucleotidesOnly_, K, off48, threads));
+  res.S.use_packed(&S);
   return res;
 }
 
 long sparseSA::index_size_in_bytes() const {
-  throw std::runtime_error("TODO: broken");
-      // long indexSize = 0L;
-      // indexSize += sizeof(sparseMult);
-      // indexSize += sizeof(hasSufLink);
-      // indexSize += sizeof(hasChild);
-      // indexSize += sizeof(K);
-      // indexSize += sizeof(NKm1);
-      // indexSize += sizeof(logN);
-      // indexSize += sizeof(N);
-      // indexSize += sizeof(_4column);
-      // indexSize += sizeof(hasKmer);
-      // indexSize += sizeof(kMerSize);
-      // indexSize += sizeof(kMerTableSize);
-      // indexSize += sizeof(nucleotidesOnly);
-      // indexSize += S.capacity();
-      // indexSize += sizeof(SA) + SA.capacity()*sizeof(unsigned int);
-      // indexSize += sizeof(ISA) + ISA.capacity()*sizeof(int);
-      // indexSize += sizeof(CHILD) + CHILD.capacity()*sizeof(int);
-      // indexSize += sizeof(KMR) + KMR.capacity()*(2*sizeof(unsigned int));
-      // indexSize += LCP.index_size_in_bytes();
-      // return indexSize;
+  long indexSize = 0L;
+  indexSize += sizeof(sparseSA_aux);
+  indexSize += sizeof(kMerTableSize);
+  indexSize += SA.bytes();
+  indexSize += ISA.bytes();
+  indexSize += sizeof(int) * CHILD.size();
+  indexSize += sizeof(saTuple_t) * KMR.size();
+  indexSize += LCP.index_size_in_bytes();
+  return indexSize;
 }
 
 // Uses the algorithm of Kasai et al 2001 which was described in
 // Manzini 2004 to compute the LCP array. Modified to handle sparse
 // suffix arrays and inverse sparse suffix arrays.
-void sparseSA::computeLCP() {
+void sparseSA::computeLCP(int threads) {
   TIME_FUNCTION;
-  sparseSA_imp::computeLCP(LCP, S, SA, ISA, N, K);
+  sparseSA_imp::computeLCP(LCP, S, SA, ISA, N, K, threads);
 }
 
 // Child array construction algorithm
@@ -145,18 +148,39 @@ void sparseSA::computeChild() {
         }
 }
 
-// Look-up table construction algorithm
-void sparseSA::computeKmer() {
+// Look-up table construction algorithm. With several threads, the
+// intervals of the first few characters are found first, and the
+// subtrees below them are filled in parallel. Every table entry belongs
+// to one subtree, so the table does not depend on the thread count.
+void sparseSA::computeKmer(int threads) {
   TIME_FUNCTION;
 
+    const interval_t root(0,N/K-1,0);
+    if(threads <= 1 || kMerSize <= 1) {
+        computeKmer(root, 0, kMerSize, nullptr);
+        return;
+    }
+
+    std::vector<std::pair<interval_t, unsigned int> > subtrees;
+    computeKmer(root, 0, std::min(kMerSize - 1, 3L), &subtrees);
+
+    std::atomic<size_t> next(0);
+    sparseSA_imp::run_threads(threads, [&](int t) {
+        for(size_t k = next++; k < subtrees.size(); k = next++)
+            computeKmer(subtrees[k].first, subtrees[k].second, kMerSize, nullptr);
+      });
+}
+
+void sparseSA::computeKmer(const interval_t& root, unsigned int rootIndex, long split,
+                           std::vector<std::pair<interval_t, unsigned int> >* subtrees) {
     std::stack<interval_t> intervalStack;
     std::stack<unsigned int> indexStack;
 
-    interval_t curInterval(0,N/K-1,0);
-    unsigned int curIndex = 0;
+    interval_t curInterval = root;
+    unsigned int curIndex = rootIndex;
     unsigned int newIndex = 0;
 
-    intervalStack.push(interval_t(0,N/K-1,0));
+    intervalStack.push(root);
     indexStack.push(curIndex);
 
     while(!intervalStack.empty()){
@@ -168,6 +192,9 @@ void sparseSA::computeKmer() {
                 KMR[curIndex].right = curInterval.end;
             }
         }
+        else if(subtrees && curInterval.depth >= split){
+            subtrees->push_back(std::make_pair(curInterval, curIndex));
+        }
         else{
             if(hasChild){//similar to function traverse_faster
                 //walk up to depth KMERSIZE or new child
@@ -455,55 +482,155 @@ bool sparseSA::load(const std::string &prefix) {
   return true;
 }
 
-void sparseSA::construct(bool off48){
+// Implements a variant of American flag sort (McIlroy radix sort).
+// Recurse until big-K size prefixes are sorted. Adapted from the C++
+// source code for the wordSA implementation from the following paper:
+// Ferragina and Fischer. Suffix Arrays on Words. CPM 2007.
+// sa[l..r] holds indices of sampled suffixes sharing their first h
+// characters. On return they are sorted by their first K characters,
+// and group of each is the last index of the suffixes sharing them.
+void sparseSA::radixStep(int *sa, int *group, long l, long r, long h) {
+  if(h == K || r - l < 16) {
+    // small bucket: sort by remaining characters directly
+    auto less = [&](int a, int b) {
+      for(long k = h; k < K; k++) {
+        const unsigned char ca = S[(long)a*K + k], cb = S[(long)b*K + k];
+        if(ca != cb) return ca < cb;
+      }
+      return false;
+    };
+    std::sort(sa + l, sa + r + 1, less);
+    for(long end = r; end >= l; ) {
+      long beg = end;
+      while(beg > l && !less(sa[beg-1], sa[end])) beg--;
+      for(long j = beg; j <= end; j++) group[sa[j]] = end;
+      end = beg - 1;
+    }
+    return;
+  }
+  // first pass: count
+  long Sigma[256] = { 0 }; // Sigma counts occurring characters in bucket
+  long BucketBegin[256]; // array to save current bucket beginnings
+  for (long i = l; i <= r; i++) Sigma[(unsigned char)S[(long)sa[i]*K + h]]++; // count characters
+  BucketBegin[0] = l; for (long i = 1; i < 256; i++) { BucketBegin[i] = Sigma[i-1] + BucketBegin[i-1]; } // accumulate
+
+  // second pass: move (this variant does *not* need an additional array!)
+  unsigned char currentKey = 0;    // character of current bucket
+  long end = l-1+Sigma[currentKey]; // end of current bucket
+  long pos = l;                     // 'pos' is current position in bucket
+  while (1) {
+    if (pos > end) { // Reached the end of the bucket.
+      if (currentKey == 255) break; // Last character?
+      currentKey++; // Advance to next characer.
+      pos = BucketBegin[currentKey]; // Next bucket start.
+      end += Sigma[currentKey]; // Next bucket end.
+    }
+    else {
+      // American flag sort of McIlroy et al. 1993. BucketBegin keeps
+      // track of current position where to add to bucket set.
+      const unsigned char c = S[(long)sa[pos]*K + h];
+      int tmp = sa[ BucketBegin[c] ];
+      sa[ BucketBegin[c]++ ] = sa[pos];  // Move bucket beginning to the right, and replace
+      sa[ pos ] = tmp; // Save value at bucket beginning.
+      if ((unsigned char)S[(long)sa[pos]*K + h] == currentKey) pos++; // Advance to next position if the right character.
+    }
+  }
+  // recursively refine buckets:
+  long beg = l; end = l-1;
+  for (long i = 0; i < 256; i++) { // step through Sigma to find bucket borders
+    end += Sigma[i];
+    if (beg <= end) {
+      radixStep(sa, group, beg, end, h+1); // recursive refinement
+      beg = end + 1; // advance to next bucket
+    }
+  }
+}
+
+// Prefix doubling of Larsson and Sadakane on the suffixes of the text
+// of K-character words. On entry, sa[0..n) is sorted by the first word
+// of each suffix, and group[i] is the last index in sa of the suffixes
+// sharing the first word of suffix i. Each pass sorts every group by
+// the group of the suffix h words further, which sorts it by its first
+// 2h words. Sorted stretches of sa are skipped, their first entry holds
+// minus their length. On return, sa is the suffix array of the word
+// text and group its inverse.
+static void suffixsort(int* sa, int* group, long n) {
+  std::vector<std::pair<int, int> > keys;
+  for(long h = 1; sa[0] != -n; h *= 2) {
+    long run = 0; // length of sorted stretch ending before a
+    for(long a = 0; a < n; ) {
+      if(sa[a] < 0) { run -= sa[a]; a -= sa[a]; continue; }
+      const long b = group[sa[a]];
+      if(a == b) { run++; a++; continue; }
+      keys.clear();
+      for(long j = a; j <= b; j++)
+        keys.push_back(std::make_pair(sa[j] + h < n ? group[sa[j] + h] : -1, sa[j]));
+      std::sort(keys.begin(), keys.end());
+      for(long j = a; j <= b; ) {
+        long e = j;
+        while(e < b && keys[e + 1 - a].first == keys[j - a].first) e++;
+        if(e == j) {
+          run++;
+        } else {
+          if(run) { sa[j - run] = -run; run = 0; }
+        }
+        for(long k = j; k <= e; k++) { sa[k] = keys[k - a].second; group[sa[k]] = e; }
+        j = e + 1;
+      }
+      a = b + 1;
+    }
+    if(run) sa[n - run] = -run;
+  }
+  for(long i = 0; i < n; i++) sa[group[i]] = i;
+}
+
+void sparseSA::construct(bool off48, int threads){
   //  TIME_FUNCTION;
 
     if(K > 1) {
-        // long bucketNr = 1;
-        // int *intSA = new int[N/K+1];
-        // for(int i = 0; i < N/K; i++) intSA[i] = i; // Init SA.
-        // int* t_new = new int[N/K+1];
-        // long* BucketBegin = new long[256]; // array to save current bucket beginnings
-        // radixStep(t_new, intSA, bucketNr, BucketBegin, 0, N/K-1, 0); // start radix sort
-        // t_new[N/K] = 0; // Terminate new integer string.
-        // delete[] BucketBegin;
-
-        throw "Not supported yet";
-        // Suffix sort integer text.
-        // std::cerr << "# suffixsort()" << std::endl;
-        // suffixsort(t_new, intSA, N/K, bucketNr, 0);
-        // std::cerr << "# DONE suffixsort()" << std::endl;
-
-        // delete[] t_new;
-
-        // // Translate suffix array.
-        // SA.resize(N/K);
-        // for (long i=0; i<N/K; i++) SA[i] = (unsigned int)intSA[i+1] * K;
-        // delete[] intSA;
-
-        // // Build ISA using sparse SA.
-        // ISA.resize(N/K);
-        // for(long i = 0; i < N/K; i++) { ISA[SA[i]/K] = i; }
+        // Sort the sampled suffixes as suffixes of the text of
+        // K-character words: radix sort on the first word, then prefix
+        // doubling. Sampled suffix indices are sorted in SA, and their
+        // groups kept in ISA, in place when these hold 32 bits.
+        const long n = N/K;
+        SA.resize(n, off48);
+        ISA.resize(n, off48);
+        std::vector<int> tmpSA, tmpISA;
+        int *sa = SA.is_small ? SA.small.data() : (tmpSA.resize(n), tmpSA.data());
+        int *group = ISA.is_small ? ISA.small.data() : (tmpISA.resize(n), tmpISA.data());
+        for(long i = 0; i < n; ++i) sa[i] = i;
+        radixStep(sa, group, 0, n-1, 0);
+        suffixsort(sa, group, n);
+
+        // Translate suffix array.
+        if(SA.is_small) {
+          for(long i = 0; i < n; ++i) SA.small[i] = sa[i] * K;
+        } else {
+          for(long i = 0; i < n; ++i) SA.large[i] = (long)sa[i] * K;
+          for(long i = 0; i < n; ++i) ISA.large[i] = group[i];
+        }
     }
     else {
       SA.resize(N, off48);
       ISA.resize(N, off48);
       if(SA.is_small) {
-        compactsufsort::create((const unsigned char*)(S + 0), (int*)SA.small.data(), N);
-//#pragma omp parallel for
-        for(long i = 0; i < N; ++i) { ISA.small[SA.small[i]] = i; }
+        compactsufsort::create((const unsigned char*)(S + 0), (int*)SA.small.data(), N, threads);
+        sparseSA_imp::run_threads(threads, [&](int t) {
+            for(long i = N * t / threads; i < N * (t + 1) / threads; ++i) { ISA.small[SA.small[i]] = i; }
+          });
       } else {
-        compactsufsort::create((const unsigned char*)(S + 0), SA.large.begin(), N);
-//#pragma omp parallel for
-        for(long i = 0; i < N; ++i) { ISA.large[SA.large[i]] = i; }
+        compactsufsort::create((const unsigned char*)(S + 0), SA.large.begin(), N, threads);
+        sparseSA_imp::run_threads(threads, [&](int t) {
+            for(long i = N * t / threads; i < N * (t + 1) / threads; ++i) { ISA.large[SA.large[i]] = i; }
+          });
       }
     }
 
     LCP.resize(N/K);
     // Use algorithm by Kasai et al to construct LCP array.
-    computeLCP();  // SA + ISA -> LCP
+    computeLCP(threads);  // SA + ISA -> LCP
     if(!hasSufLink){
-      //ISA.clear(); // TODO: clear in vector32_48
+      ISA.clear(); // only needed for suffix links from here on
     }
     if(hasChild){
         CHILD.resize(N/K);
@@ -515,63 +642,13 @@ void sparseSA::construct(bool off48){
         // std::cerr << "kmer table size: " << kMerTableSize << std::endl;
         KMR.resize(kMerTableSize, saTuple_t());
         //Use algorithm by Abouelhoda et al to construct CHILD array
-        computeKmer();
+        computeKmer(threads);
     }
 
     //    NKm1 = N/K-1;
 
 }
 
-// Implements a variant of American flag sort (McIlroy radix sort).
-// Recurse until big-K size prefixes are sorted. Adapted from the C++
-// source code for the wordSA implementation from the following paper:
-// Ferragina and Fischer. Suffix Arrays on Words. CPM 2007.
-// void sparseSA::radixStep(int *t_new, int *SA, long &bucketNr, long *BucketBegin, long l, long r, long h) {
-//   if(h >= K) return;
-//   // first pass: count
-//   std::vector<long> Sigma(256, 0); // Sigma counts occurring characters in bucket
-//   for (long i = l; i <= r; i++) Sigma[ S[ SA[i]*K + h ] ]++; // count characters
-//   BucketBegin[0] = l; for (long i = 1; i < 256; i++) { BucketBegin[i] = Sigma[i-1] + BucketBegin[i-1]; } // accumulate
-
-//   // second pass: move (this variant does *not* need an additional array!)
-//   unsigned char currentKey = 0;    // character of current bucket
-//   long end = l-1+Sigma[currentKey]; // end of current bucket
-//   long pos = l;                     // 'pos' is current position in bucket
-//   while (1) {
-//     if (pos > end) { // Reached the end of the bucket.
-//       if (currentKey == 255) break; // Last character?
-//       currentKey++; // Advance to next characer.
-//       pos = BucketBegin[currentKey]; // Next bucket start.
-//       end += Sigma[currentKey]; // Next bucket end.
-//     }
-//     else {
-//       // American flag sort of McIlroy et al. 1993. BucketBegin keeps
-//       // track of current position where to add to bucket set.
-//       int tmp = SA[ BucketBegin[(int) S[ SA[pos]*K + h ] ] ];
-//       SA[ BucketBegin[(int) S[ SA[pos]*K + h] ]++ ] = SA[pos];  // Move bucket beginning to the right, and replace
-//       SA[ pos ] = tmp; // Save value at bucket beginning.
-//       if (S[ SA[pos]*K + h ] == currentKey) pos++; // Advance to next position if the right character.
-//     }
-//   }
-//   // recursively refine buckets and calculate new text:
-//   long beg = l; end = l-1;
-//   for (long i = 1; i < 256; i++) { // step through Sigma to find bucket borders
-//     end += Sigma[i];
-//     if (beg <= end) {
-//       if(h == K-1) {
-// 	for (long j = beg; j <= end; j++) {
-// 	  t_new[ SA[j] ] = bucketNr; // set new text
-// 	}
-// 	bucketNr++;
-//       }
-//       else {
-// 	radixStep(t_new, SA, bucketNr, BucketBegin, beg, end, h+1); // recursive refinement
-//       }
-//       beg = end + 1; // advance to next bucket
-//     }
-//   }
-// }
-
 // Binary search for left boundry of interval.
 long sparseSA::bsearch_left(char c, long i, long s, long e) const {
   if(c == S[SA[s]+i]) return s;
@@ -622,6 +699,29 @@ bool sparseSA::search(const char* P, size_t Plen, long &start, long &end) const
   return true;
 }
 
+// An occurrence of P starts d < K positions before a sampled suffix,
+// which is found by a search for P[d..Plen), starting from the k-mer
+// table. Stops at the second occurrence.
+bool sparseSA::is_unique(const char* P, long Plen) const {
+  long count = 0;
+  for(long d = 0; d < K && d < Plen; d++) {
+    interval_t cur(0, N/K-1, 0);
+    traverse(P + d, Plen - d, 0, cur, Plen - d);
+    if(cur.depth == 0) { // not in k-mer table, e.g. not ACGT only
+      if(!search(P + d, Plen - d, cur.start, cur.end)) continue;
+    } else if(cur.depth < Plen - d) {
+      continue;
+    }
+    for(long i = cur.start; i <= cur.end; i++) {
+      const long s = SA[i] - d;
+      if(s < 0) continue;
+      long j = 0;
+      while(j < d && S[s + j] == P[j]) j++;
+      if(j == d && ++count > 1) return false;
+    }
+  }
+  return count == 1;
+}
 
 // Traverse pattern P starting from a given prefix and interval
 // until mismatch or min_len characters reached.
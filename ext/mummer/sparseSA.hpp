@@ -12,6 +12,8 @@
 #include <cstring>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <cctype>
 
 #include "48bit_index.hpp"
 #include "openmp_qsort.hpp"
@@ -48,9 +50,64 @@ static const unsigned int BITADD[256] = {
   UINT_MAX, UINT_MAX, UINT_MAX, UINT_MAX, UINT_MAX, UINT_MAX, UINT_MAX, UINT_MAX, UINT_MAX, UINT_MAX,//240-249
   UINT_MAX, UINT_MAX, UINT_MAX, UINT_MAX, UINT_MAX, UINT_MAX };//250-255
 
+// Array that either owns its elements (std::vector) or refers in
+// place to read-only memory owned elsewhere, e.g. a memory-mapped
+// index file. Element access goes through a single pointer in both
+// cases.
+template<typename T>
+struct mappable_array {
+  std::vector<T> own;
+  T*             ptr = nullptr;
+  size_t         len = 0;
+
+  mappable_array() = default;
+  mappable_array(size_t N, const T& v) : own(N, v), ptr(own.data()), len(N) { }
+  mappable_array(const mappable_array& rhs) : own(rhs.own), ptr(rhs.is_mapped() ? rhs.ptr : own.data()), len(rhs.len) { }
+  mappable_array(mappable_array&& rhs) : own(std::move(rhs.own)), ptr(rhs.ptr), len(rhs.len) {
+    rhs.ptr = nullptr;
+    rhs.len = 0;
+  }
+  mappable_array& operator=(mappable_array rhs) {
+    own.swap(rhs.own);
+    std::swap(ptr, rhs.ptr);
+    std::swap(len, rhs.len);
+    return *this;
+  }
+
+  void resize(size_t N, const T& v = T()) {
+    own.resize(N, v);
+    ptr = own.data();
+    len = N;
+  }
+  // Use N elements at p in place, p must outlive this array and is
+  // never written to.
+  void map(const T* p, size_t N) {
+    std::vector<T>().swap(own);
+    ptr = const_cast<T*>(p);
+    len = N;
+  }
+  bool is_mapped() const { return len > 0 && ptr != own.data(); }
+
+  // Append to owned elements, never called on a mapped array.
+  void push_back(const T& v) {
+    own.push_back(v);
+    ptr = own.data();
+    len = own.size();
+  }
+
+  T& operator[](size_t i) { return ptr[i]; }
+  const T& operator[](size_t i) const { return ptr[i]; }
+  T& back() { return ptr[len - 1]; }
+  const T& back() const { return ptr[len - 1]; }
+  T* data() { return ptr; }
+  const T* data() const { return ptr; }
+  size_t size() const { return len; }
+  size_t capacity() const { return is_mapped() ? 0 : own.capacity(); }
+};
+
 // Either a vector of 32-bits offsets, or 48-bits.
 struct vector_32_48 {
-  std::vector<int>          small; // Suffix array.
+  mappable_array<int>       small; // Suffix array.
   fortyeight_index<int64_t> large;
   bool is_small;
   void resize(size_t N, bool force_large = false) {
@@ -63,6 +120,14 @@ struct vector_32_48 {
   size_t size() const {
     return is_small ? small.size() : large.size();
   }
+  size_t bytes() const {
+    return is_small ? small.size() * sizeof(int) : large.size() * (sizeof(uint32_t) + sizeof(uint16_t));
+  }
+  // Release all memory
+  void clear() {
+    small = mappable_array<int>();
+    large.resize(0);
+  }
   long operator[](size_t i) const {
     return is_small ? small[i] : large[i];
   }
@@ -79,6 +144,177 @@ struct vector_32_48 {
 };
 
 
+// Run of identical residues other than A, C, G, T (e.g. N, IUPAC codes
+// or record separators) in a packed_text.
+struct packed_run {
+  uint64_t start;
+  uint32_t length;
+  char     c;
+  char     reserved[3]; // zero, runs are written to index files as is
+};
+
+// Nucleotide sequence stored at 2 bits per residue, 32 residues per
+// word (A=0, C=1, G=2, T=3, first residue in the low bits). Other
+// residues are kept in a sorted side list of runs, their 2-bit code
+// is 0. One flag bit per word marks words overlapping a run, so that
+// access to plain ACGT residues is a word load and a shift, and only
+// flagged words search the side list. Arrays can be mapped from an
+// index file like the suffix array itself.
+struct packed_text {
+  mappable_array<uint64_t>   words; // one zero word of padding at the end
+  mappable_array<uint64_t>   flags; // bit w set if word w overlaps a run
+  mappable_array<packed_run> runs;
+  size_t                     len = 0;
+
+  packed_text() { clear(); }
+
+  void clear() {
+    words.resize(0); words.push_back(0);
+    flags.resize(0); flags.push_back(0);
+    runs.resize(0);
+    len = 0;
+  }
+
+  size_t size() const { return len; }
+  size_t length() const { return len; }
+  size_t bytes() const { return (words.size() + flags.size()) * sizeof(uint64_t) + runs.size() * sizeof(packed_run); }
+
+  static int code(char c) {
+    switch(c) {
+    case 'A': case 'a': return 0;
+    case 'C': case 'c': return 1;
+    case 'G': case 'g': return 2;
+    case 'T': case 't': return 3;
+    default: return -1;
+    }
+  }
+
+  bool flagged(size_t w) const { return (flags[w >> 6] >> (w & 63)) & 1; }
+
+  // Residue at i, i < size().
+  char operator[](size_t i) const {
+    const size_t w = i >> 5;
+    if(__builtin_expect(flagged(w), 0)) {
+      const packed_run* r = run_at(i);
+      if(r) return r->c;
+    }
+    return "ACGT"[(words[w] >> ((i & 31) << 1)) & 3];
+  }
+
+  // Run containing position i, NULL if residue i is A, C, G or T.
+  const packed_run* run_at(size_t i) const {
+    const packed_run* end = runs.data() + runs.size();
+    const packed_run* r   = std::upper_bound(runs.data(), end, (uint64_t)i,
+                                             [](uint64_t p, const packed_run& x) { return p < x.start; });
+    if(r == runs.data()) return nullptr;
+    --r;
+    return i < r->start + r->length ? r : nullptr;
+  }
+
+  // Append n residues at s, lower case is converted to upper case.
+  void append(const char* s, size_t n) {
+    for(size_t i = 0; i < n; ++i) push_back(s[i]);
+  }
+
+  void push_back(char c) {
+    const size_t w = len >> 5;
+    if(w + 1 >= words.size()) words.push_back(0);
+    if((w + 1) >> 6 >= flags.size()) flags.push_back(0);
+    const int x = code(c);
+    if(x >= 0) {
+      words[w] |= (uint64_t)x << ((len & 31) << 1);
+    } else {
+      c = ::toupper((unsigned char)c);
+      if(runs.size() > 0 && runs.back().c == c && runs.back().start + runs.back().length == len)
+        runs.back().length++;
+      else
+        runs.push_back(packed_run{len, 1, c});
+      flags[w >> 6] |= (uint64_t)1 << (w & 63);
+    }
+    ++len;
+  }
+
+  // Append all residues of rhs.
+  void append(const packed_text& rhs) {
+    const size_t offset = len;
+    const size_t shift  = (len & 31) << 1;
+    for(size_t k = 0; k < (rhs.len + 31) / 32; ++k) {
+      const size_t w = (offset >> 5) + k;
+      while(w + 2 >= words.size()) words.push_back(0);
+      words[w] |= rhs.words[k] << shift;
+      if(shift) words[w + 1] |= rhs.words[k] >> (64 - shift);
+    }
+    len += rhs.len;
+    for(size_t w = (len >> 5) + 1; (w >> 6) >= flags.size(); ) flags.push_back(0);
+    for(size_t k = 0; k < rhs.runs.size(); ++k) {
+      packed_run r = rhs.runs[k];
+      r.start += offset;
+      if(runs.size() > 0 && runs.back().c == r.c && runs.back().start + runs.back().length == r.start)
+        runs.back().length += r.length;
+      else
+        runs.push_back(r);
+      for(size_t w = r.start >> 5; w <= (r.start + r.length - 1) >> 5; ++w)
+        flags[w >> 6] |= (uint64_t)1 << (w & 63);
+    }
+  }
+
+  // Residues [pos, pos + n) as characters into out.
+  void unpack(size_t pos, size_t n, std::string& out) const {
+    out.resize(n);
+    for(size_t i = 0; i < n; ++i)
+      out[i] = "ACGT"[(words[(pos + i) >> 5] >> (((pos + i) & 31) << 1)) & 3];
+    const packed_run* end = runs.data() + runs.size();
+    const packed_run* r   = std::upper_bound(runs.data(), end, (uint64_t)pos,
+                                             [](uint64_t p, const packed_run& x) { return p < x.start; });
+    if(r != runs.data()) --r;
+    for(; r != end && r->start < pos + n; ++r)
+      for(size_t i = std::max<uint64_t>(r->start, pos); i < std::min<uint64_t>(r->start + r->length, pos + n); ++i)
+        out[i - pos] = r->c;
+  }
+
+  // 32 residue codes starting at i.
+  uint64_t window(size_t i) const {
+    const size_t w = i >> 5, shift = (i & 31) << 1;
+    return shift ? (words[w] >> shift) | (words[w + 1] << (64 - shift)) : words[w];
+  }
+
+  // Length of the longest common prefix of the suffixes at i and j,
+  // at most max and not beyond the end. Compares 32 residues at a time
+  // unless a window overlaps a run.
+  size_t common_prefix(size_t i, size_t j, size_t max) const {
+    max = std::min(max, len - std::max(i, j));
+    size_t h = 0;
+    while(h < max) {
+      const size_t a = i + h, b = j + h, n = std::min<size_t>(32, max - h);
+      if(flagged(a >> 5) || flagged((a + 31) >> 5) || flagged(b >> 5) || flagged((b + 31) >> 5)) {
+        for(const size_t end = h + n; h < end; ++h)
+          if((*this)[i + h] != (*this)[j + h]) return h;
+        continue;
+      }
+      const uint64_t x = window(a) ^ window(b);
+      if(x) {
+        const size_t m = __builtin_ctzll(x) >> 1;
+        if(m < n) return h + m;
+      }
+      h += n;
+    }
+    return h;
+  }
+
+  // 64-bit FNV-1a hash over the packed residues, padding excluded.
+  uint64_t checksum() const {
+    uint64_t h = 14695981039346656037ULL;
+    auto mix = [&](uint64_t x) { h ^= x; h *= 1099511628211ULL; };
+    mix(len);
+    for(size_t k = 0; k < (len + 31) / 32; ++k) mix(words[k]);
+    for(size_t k = 0; k < runs.size(); ++k) {
+      mix(runs[k].start);
+      mix(((uint64_t)runs[k].length << 8) | (unsigned char)runs[k].c);
+    }
+    return h;
+  }
+};
+
 // Stores the LCP array in an unsigned char (0-255).  Values larger
 // than or equal to 255 are stored in a sorted array.
 // Simulates a vector<int> LCP;
@@ -92,6 +328,7 @@ struct vec_uchar {
     item_t(size_t i, large_type v) : idx(i), val(v) { }
     size_t idx;
     large_type val;
+    large_type reserved = 0; // explicit padding, M is written to index files as is
     bool operator < (const item_t& t) const { return idx < t.idx; }
     bool operator==(const item_t& t) const { return idx == t.idx && val == t.val; }
   };
@@ -100,14 +337,18 @@ struct vec_uchar {
   }
 
   typedef std::vector<item_t> item_vector;
-  std::vector<small_type> vec;  // LCP values from 0-65534
+  mappable_array<small_type> vec;  // LCP values from 0-65534
   item_vector             M;
+  const item_t*           M_mapped = nullptr; // In place copy of M (e.g. memory-mapped), used instead of M if set
+  size_t                  M_mapped_size = 0;
   vector_32_48*           sa;
 
   vec_uchar(vector_32_48& sa_) : vec(sa_.size(), 0), sa(&sa_) { }
   vec_uchar(vec_uchar&& rhs, vector_32_48& sa_)
     : vec(std::move(rhs.vec))
     , M(std::move(rhs.M))
+    , M_mapped(rhs.M_mapped)
+    , M_mapped_size(rhs.M_mapped_size)
     , sa(&sa_)
   { }
   vec_uchar(const std::string& path, vector_32_48& sa_) : sa(&sa_) {
@@ -120,8 +361,10 @@ struct vec_uchar {
     const large_type res = vec[idx];
     if(res != max) return res;
     idx = (*sa)[idx];
-    auto it = upper_bound(M.begin(), M.end(), item_t(idx));
-    assert(it != M.begin());
+    const item_t* Mb = M_mapped ? M_mapped : M.data();
+    const item_t* Me = M_mapped ? M_mapped + M_mapped_size : M.data() + M.size();
+    auto it = std::upper_bound(Mb, Me, item_t(idx));
+    assert(it != Mb);
     --it;
     return it->val - (idx - it->idx);
   }
@@ -152,8 +395,8 @@ struct vec_uchar {
 
   long index_size_in_bytes() const {
       long indexSize = 0L;
-      indexSize += sizeof(vec) + vec.capacity()*sizeof(small_type);
-      indexSize += sizeof(M) + M.capacity()*(sizeof(size_t)+sizeof(large_type));
+      indexSize += sizeof(vec) + vec.size()*sizeof(small_type);
+      indexSize += sizeof(M) + (M.size() + M_mapped_size)*sizeof(item_t);
       return indexSize;
   }
 };
@@ -193,10 +436,13 @@ struct interval_t {
   long size() const { return end - start + 1; }
 };
 
+// Text of a suffix array, as characters or packed (or both while the
+// suffix array is built; characters are then preferred for access).
 struct bounded_string {
-  const char* const s_;
-  const size_t      al_; // actual length
-  size_t            l_;  // length rounded to K
+  const char*        s_;
+  const packed_text* p_ = nullptr;
+  size_t             al_; // actual length
+  size_t             l_;  // length rounded to K
 
   static long compute_l(size_t l, long K) {
     return l + K + (l % K != 0 ? K - (l % K) : 0);
@@ -208,16 +454,46 @@ struct bounded_string {
   { }
   bounded_string(const std::string s, long K) : bounded_string(s.c_str(), s.size(), K) { }
   bounded_string(const char* s, long K) : bounded_string(s, strlen(s), K) { }
+  bounded_string(const packed_text* p, long K)
+    : s_(nullptr)
+    , p_(p)
+    , al_(p->size())
+    , l_(compute_l(al_, K))
+  { }
 
   void set_k(long K) {
     l_ = compute_l(al_, K);
   }
 
+  // Switch to packed text p holding the same residues, characters are
+  // no longer referenced.
+  void use_packed(const packed_text* p) {
+    p_ = p;
+    s_ = nullptr;
+  }
+
   char operator[](size_t i) const {
     if(__builtin_expect(i < al_, 1))
-      return s_[i];
+      return s_ ? s_[i] : (*p_)[i];
     return '$';
   }
+
+  // Length of the longest common prefix of suffixes i and j, at most
+  // max, '$' padding beyond the end included. Short prefixes are
+  // settled on characters when present, long ones (repeats) 32
+  // residues at a time on the packed text.
+  size_t common_prefix(size_t i, size_t j, size_t max) const {
+    const size_t fit = std::max(i, j) < al_ ? std::min(max, al_ - std::max(i, j)) : 0;
+    size_t h = 0;
+    if(s_) {
+      const size_t first = p_ ? std::min<size_t>(fit, 32) : fit;
+      while(h < first && s_[i + h] == s_[j + h]) ++h;
+    }
+    if(p_ && h == std::min<size_t>(fit, s_ ? 32 : 0)) h += p_->common_prefix(i + h, j + h, fit - h);
+    while(h < max && (*this)[i + h] == (*this)[j + h]) ++h;
+    return h;
+  }
+
   size_t size() const noexcept { return l_; }
   size_t length() const noexcept { return l_; }
   size_t capacity() const noexcept { return l_; }
@@ -275,7 +551,7 @@ struct sparseSA : sparseSA_aux {
   vector_32_48              ISA; // Inverse suffix array
   vec_uchar                 LCP; // Simulates a vector<int> LCP.
   std::vector<int>          CHILD; //child table
-  std::vector<saTuple_t>    KMR;
+  mappable_array<saTuple_t> KMR;
 
   //fields for lookup table of sa intervals to a certain small depth
   long kMerTableSize;
@@ -294,6 +570,11 @@ struct sparseSA : sparseSA_aux {
            int sparseMult_, int kMerSize_, bool nucleotidesOnly_)
     : sparseSA(S_.c_str(), S_.length(), __4column, K_, suflink_, child_, kmer_, sparseMult_, kMerSize_, nucleotidesOnly_)
   { }
+  sparseSA(const packed_text& S_, bool __4column, long K_, bool suflink_, bool child_, bool kmer_,
+           int sparseMult_, int kMerSize_, bool nucleotidesOnly_)
+    : sparseSA(bounded_string(&S_, K_),
+               __4column, K_, suflink_, child_, kmer_, sparseMult_, kMerSize_, nucleotidesOnly_)
+  { }
   // Constructor load sparse suffix array from file
   sparseSA(const char* S_, size_t Slen, const std::string& prefix)
     : S(S_, Slen, 1)
@@ -316,18 +597,32 @@ struct sparseSA : sparseSA_aux {
     , kMerTableSize(rhs.kMerTableSize)
   { }
 
-  static sparseSA create_auto(const char* S, size_t Slen, int min_len, bool nucleotidesOnly_, int K = 1, bool off48 = false);
+  // The suffix array is built with 'threads' threads. The result is the
+  // same for any thread count.
+  static sparseSA create_auto(const char* S, size_t Slen, int min_len, bool nucleotidesOnly_, int K = 1, bool off48 = false, int threads = 1);
+  // Suffix array over packed text S, which must outlive it. Characters
+  // are unpacked for construction only.
+  static sparseSA create_auto(const packed_text& S, int min_len, bool nucleotidesOnly_, int K = 1, bool off48 = false, int threads = 1);
+  static sparseSA create_auto(bounded_string&& S, int min_len, bool nucleotidesOnly_, int K = 1, bool off48 = false, int threads = 1);
 
   // Modified Kasai et all for LCP computation.
-  void computeLCP();
+  void computeLCP(int threads = 1);
   //Modified Abouelhoda et all for CHILD Computation.
   void computeChild();
   //build look-up table for sa intervals of kmers up to some depth
-  void computeKmer();
+  void computeKmer(int threads = 1);
+  // Fill look-up table below interval root of k-mer index rootIndex. If
+  // subtrees is set, intervals of depth split are appended to it instead
+  // of being descended into.
+  void computeKmer(const interval_t& root, unsigned int rootIndex, long split,
+                   std::vector<std::pair<interval_t, unsigned int> >* subtrees);
+
+  // Radix sort of sampled suffixes by their first K characters, first
+  // step of sparse SA construction.
+  void radixStep(int *sa, int *group, long l, long r, long h);
 
-  // Not used at this point
-  // Radix sort required to construct transformed text for sparse SA construction.
-  // void radixStep(int *t_new, int *SA, long &bucketNr, long *BucketBegin, long l, long r, long h);
+  // Whether P[0..Plen) occurs exactly once in S.
+  bool is_unique(const char* P, long Plen) const;
 
   // Binary search for left boundry of interval.
   inline long bsearch_left(char c, long i, long s, long e) const;
@@ -414,11 +709,9 @@ struct sparseSA : sparseSA_aux {
   // P throught he index.  Consequently, repeats can occur in the
   // pattern P.
   void MAM(const std::string& P, int min_len, bool flip_forward, std::vector<match_t>& matches) const {
-    if(K != 1) return;  // Only valid for full suffix array.
     findMAM(P, min_len, flip_forward, matches);
   }
   void MAM(const char* P, size_t Plen, int min_len, bool flip_forward, std::vector<match_t>& matches) const {
-    if(K != 1) return;  // Only valid for full suffix array.
     findMAM(P, Plen, min_len, flip_forward, matches);
   }
 
@@ -475,7 +768,7 @@ struct sparseSA : sparseSA_aux {
   bool load(const std::string &prefix);
 
   //construct
-  void construct(bool off48 = false);
+  void construct(bool off48 = false, int threads = 1);
 };
 
 // Like the sparseSA, but also know the position of the sub-sequences
@@ -508,7 +801,6 @@ public:
     findMAM_each(P, min_len, flip_forward, [&](const match_t& m) { print_match(os, m); });
   }
   void MAM(const std::string& P, int min_len, bool flip_forward, std::ostream& os) const {
-    if(sparseSA::K != 1) return;  // Only valid for full suffix array.
     findMAM(P, min_len, flip_forward, os);
   }
   void MAM(const std::string& P, int min_len, bool flip_forward, std::vector<match_t>& matches) const {
@@ -544,6 +836,17 @@ public:
 // given query pattern P, but occur uniquely in the indexed reference S.
 template<typename Output>
 void sparseSA::findMAM_each(const char* P, size_t Plen, int min_len, bool flip_forward, Output out) const {
+  if(K > 1) {
+    // The longest match at a query position is a MAM if it occurs once
+    // in S, it is then also a MEM. The suffix links below need every
+    // suffix, so MEMs are found instead and the unique ones are kept.
+    findMEM_each(P, Plen, min_len, false, [&](const match_t& m) {
+        if(is_unique(P + m.query, m.len))
+          out(make_match(m.ref, !flip_forward ? m.query : (long)Plen-1-m.query, m.len, Plen));
+      });
+    return;
+  }
+
   interval_t cur(0, N-1, 0);
   long       prefix  = 0;
 
@@ -576,20 +879,17 @@ void sparseSA::findMAM_each(const char* P, size_t Plen, int min_len, bool flip_f
 }
 
 // Maximal Unique Match (MUM)
+// Keeps MUM candidates (MAMs) that are not contained in another
+// candidate on the reference, and outputs them in reference order.
+// Adapted from Stephan Kurtz's code in cleanMUMcand.c in MUMMer v3.20.
 template<typename Output>
-void sparseSA::findMUM_each(const char* P, size_t Plen, int min_len, bool flip_forward, Output out) const {
-  // Find unique MEMs.
-  std::vector<match_t> matches;
-  MAM(P, Plen, min_len, flip_forward, matches);
-  //  memCount=0;
-
+void cleanMUMcand(std::vector<match_t>& matches, Output out) {
   struct by_ref {
     bool operator() (const match_t &a, const match_t &b) const {
       return (a.ref == b.ref) ? a.len > b.len : a.ref < b.ref;
     }
   };
 
-  // Adapted from Stephan Kurtz's code in cleanMUMcand.c in MUMMer v3.20.
   long currentright, dbright         = 0;
   bool ignorecurrent, ignoreprevious = false;
   sort(matches.begin(), matches.end(), by_ref());
@@ -616,6 +916,16 @@ void sparseSA::findMUM_each(const char* P, size_t Plen, int min_len, bool flip_f
     out(matches.back());
 }
 
+template<typename Output>
+void sparseSA::findMUM_each(const char* P, size_t Plen, int min_len, bool flip_forward, Output out) const {
+  // Find unique MEMs.
+  std::vector<match_t> matches;
+  MAM(P, Plen, min_len, flip_forward, matches);
+  //  memCount=0;
+
+  cleanMUMcand(matches, out);
+}
+
 // For a given offset in the prefix k, find all MEMs.
 template<typename Output>
 void sparseSA::findMEM_k_each(const char* P, size_t Plen, long k, int min_len, bool flip_forward, Output out) const {
@@ -6,33 +6,61 @@
 #include <omp.h>
 #endif
 
+#include <thread>
+#include <vector>
+
 // Implementation of some sparseSA functions
 namespace mummer {
 namespace sparseSA_imp {
 
+// Run fn(t) for t in [0, threads), fn(0) on the calling thread.
+template<typename Fn>
+void run_threads(int threads, Fn fn) {
+  std::vector<std::thread> workers;
+  for(int t = 1; t < threads; ++t)
+    workers.emplace_back(fn, t);
+  fn(0);
+  for(auto& w : workers)
+    w.join();
+}
+
 #ifndef _OPENMP
+// Each thread runs Kasai et al. over its own range of text positions,
+// starting again from h = 0. Large values are gathered per thread and
+// sorted together by init(), so the result does not depend on the
+// thread count.
 template<typename Map, typename Seq, typename Vec>
-void computeLCP(Map& LCP, const Seq& S, const Vec& SA, const Vec& ISA, const long N, const long K) {
-  long h = 0;
-  for(long i = 0; i < N / K; ++i) {
-    const long m = ISA[i];
-    if(m > 0) {
-      const long bj  = SA[m-1];
-      const long bi = i * K;
-      while(bi + h < N && bj + h < N && S[bi + h] == S[bj + h])  ++h;
-      LCP.set(m, h); //LCP[m] = h;
-    } else {
-      LCP.set(m, 0); // LCP[m]=0;
-    }
-    h = std::max(0L, h - K);
-  }
+void computeLCP(Map& LCP, const Seq& S, const Vec& SA, const Vec& ISA, const long N, const long K, const int threads = 1) {
+  std::vector<typename Map::item_vector> Ms(threads);
+
+  run_threads(threads, [&](int t) {
+      const long begin = N / K * t / threads;
+      const long end   = N / K * (t + 1) / threads;
+      long h = 0;
+      for(long i = begin; i < end; ++i) {
+        const long m = ISA[i];
+        if(m > 0) {
+          const long bj  = SA[m-1];
+          const long bi = i * K;
+          h += S.common_prefix(bi + h, bj + h, N - std::max(bi, bj) - h);
+          LCP.set(m, h, Ms[t]); //LCP[m] = h;
+        } else {
+          LCP.set(m, 0, Ms[t]); // LCP[m]=0;
+        }
+        h = std::max(0L, h - K);
+      }
+    });
+
+  LCP.M = std::move(Ms[0]);
+  for(int t = 1; t < threads; ++t)
+    LCP.M.insert(LCP.M.end(), Ms[t].begin(), Ms[t].end());
   LCP.init();
 }
 
 #else // _OPENMP
 
 template<typename Map, typename Seq, typename Vec>
-void computeLCP(Map& LCP, const Seq& S, const Vec& SA, const Vec& ISA, const long N, const long K) {
+void computeLCP(Map& LCP, const Seq& S, const Vec& SA, const Vec& ISA, const long N, const long K, const int threads = 1) {
   //  const long chunk = std::min((long)10000000, (long)(N / omp_get_num_threads()));
   std::vector<typename Map::item_vector> Ms;
 
@@ -3,7 +3,7 @@
 #include <vector>
 #include <tuple>
 #include <algorithm>
-#include <zlib.h>  
+#include <zlib.h>
 #include <string>
 #include <chrono>
 #include <stdlib.h>
@@ -13,62 +13,227 @@
 #include "kseq/kseq.h"
 #include "prettyprint/prettyprint.hpp"
 #include "minimap2-2.24/minimap.h"
+#include "minimap2-2.24/mmpriv.h"
 
 //own includes
 #include "parseCmdArgs.hpp"
 #include "algo.hpp"
+#include "paf.hpp"
 
 #undef VERBOSE
 #define VERBOSE 0
 
-int main(int argc, char **argv) 
+/**
+ * @brief   alternative anchor source: exact k-mer matches between query and target found
+ *          through a minimap2 minimizer index, chained with the same engine as chainX
+ **/
+int main(int argc, char **argv)
 {
   chainx::Parameters parameters;
-  chainx::parseandSave_chainx(argc, argv, parameters);
-
-  std::vector<std::string> queries; //one or multiple sequences
-  std::vector<std::string> query_ids;
-  std::vector<std::string> target; //single sequence
-  std::vector<std::string> target_ids;
-
-  chainx::readSequences(parameters.qfile, queries, query_ids);
-  chainx::readSequences(parameters.tfile, target, target_ids);
+  chainx::parseandSave_minimizer(argc, argv, parameters);
 
   /*********** MINIMAP2 API ****************/
   mm_idxopt_t iopt;
   mm_mapopt_t mopt;
-  int n_threads = 1;
 
   mm_verbose = 2; // disable message output to stderr
   mm_set_opt(0, &iopt, &mopt);
-  mopt.flag |= MM_F_CIGAR; // perform alignment
-  mopt.flag |= MM_F_FOR_ONLY; //forward strand only
+  iopt.k = parameters.minLen;
+  iopt.w = parameters.window;
+  iopt.batch_size = UINT64_MAX; //whole target in one index
 
-  // open query file for reading; you may use your favorite FASTA/Q parser
-  gzFile f = gzopen(parameters.qfile.c_str(), "r");
-  assert(f);
-  kseq_t *ks = kseq_init(f);
+  //Start timer
+  auto tStart = std::chrono::system_clock::now();
+  std::cerr << "\nINFO, chainx-minimizer::main, timer set\n";
 
   mm_idx_reader_t *r = mm_idx_reader_open(parameters.tfile.c_str(), &iopt, 0); //index target
-  mm_idx_t *mi;
-  while ((mi = mm_idx_reader_read(r, n_threads)) != 0) {
-    mm_mapopt_update(&mopt, mi);
-    mopt.mid_occ = 0; //do not ignore high frequency minimizers
-    mm_tbuf_t *tbuf = mm_tbuf_init(); // thread buffer; for multi-threading, allocate one tbuf for each thread
-    gzrewind(f);
-    kseq_rewind(ks);
-    while (kseq_read(ks) >= 0) { // each kseq_read() call reads one query sequence
-      int j, i, n_reg;
-      mm_reg1_t *reg;
-      reg = mm_map(mi, ks->seq.l, ks->seq.s, &n_reg, tbuf, &mopt, 0); // get all hits for the query
-      free(reg);
-    }
-    mm_tbuf_destroy(tbuf);
-    mm_idx_destroy(mi);
+  mm_idx_t *mi = r ? mm_idx_reader_read(r, parameters.threads) : 0;
+  if (mi == 0 || mi->n_seq == 0)
+  {
+    std::cerr << "ERROR, chainx-minimizer::main, target sequence file could not be indexed" << std::endl;
+    exit(1);
   }
   mm_idx_reader_close(r); // close the index reader
-  kseq_destroy(ks); // close the query file
-  gzclose(f);
 
+  std::size_t refLenSum = 0;
+  for (uint32_t rid = 0; rid < mi->n_seq; rid++) refLenSum += mi->seq[rid].len;
+  bool multi = mi->n_seq > 1;
+  std::cerr << "INFO, chainx-minimizer::main, read target, " << refLenSum << " residues";
+  if (multi) std::cerr << " in " << mi->n_seq << " records";
+  std::cerr << "\n";
+
+  std::chrono::duration<double> wctduration = (std::chrono::system_clock::now() - tStart);
+  std::cerr << "INFO, chainx-minimizer::main, minimizer index computed in " << wctduration.count() << " seconds\n";
+
+  //records in increasing order of length, to find the cheapest record without anchors
+  std::vector<int> records_by_length (mi->n_seq);
+  for (uint32_t rid = 0; rid < mi->n_seq; rid++) records_by_length[rid] = rid;
+  std::stable_sort(records_by_length.begin(), records_by_length.end(), [&](int x, int y) { return mi->seq[x].len < mi->seq[y].len; });
+
+  //per-worker buffers, reused across queries; at most one candidate per record
+  //the minimizer index is shared read-only
+  mm128_v no_minimizers = {0, 0, 0};
+  std::vector<mm128_v> worker_minimizers (parameters.threads, no_minimizers);
+  std::vector<std::vector<chainx::ChainCandidate>> worker_candidates (parameters.threads);
+  std::vector<std::vector<chainx::AnchorCollector>> worker_collectors (parameters.threads);
+  std::vector<std::vector<int>> worker_slot (parameters.threads);
+  std::vector<chainx::AnchorSorter> worker_sorter (parameters.threads);
+  std::vector<std::vector<int>> worker_chain (parameters.threads);
+
+  //minimizers are visited in query order, so global chaining keys anchors on query start
+  bool semiglobal = parameters.mode == "sg";
+  bool transposed = !semiglobal;
+
+  //pipeline: parsing thread -> worker threads (one batch at a time) -> output thread
+  chainx::SequenceStream stream (parameters.qfile);
+  chainx::OutputWriter writer;
+  std::size_t queryCount = 0, queryLenSum = 0;
+
+  while (chainx::SequenceBatch *next_batch = stream.next())
+  {
+    const chainx::SequenceBatch &batch = *next_batch;
+    const std::vector<std::string> &queries = batch.seqs;
+    const std::vector<std::string> &query_ids = batch.ids;
+    chainx::OrderedOutput output (batch.size(), &writer);
+
+    chainx::parallel_for(batch.size(), parameters.threads, [&](int t, std::size_t i)
+    {
+      chainx::Transcript log;
+      log.err() << "\nINFO, chainx-minimizer::main, timer reset\n";
+      auto tStart = std::chrono::system_clock::now();
+      int len_qry = queries[i].length();
+
+      //minimizers of the query, each looked up in the target index; a hit on the same
+      //strand is an exact k-mer match, reported at the last base of both k-mers
+      mm128_v &minimizers = worker_minimizers[t];
+      minimizers.n = 0;
+      if (len_qry > 0) mm_sketch(0, queries[i].data(), len_qry, iopt.w, iopt.k, 0, 0, &minimizers);
+
+      std::vector<chainx::ChainCandidate> &candidates = worker_candidates[t];
+      std::vector<chainx::AnchorCollector> &collectors = worker_collectors[t];
+      std::vector<int> &slot = worker_slot[t];
+      if (candidates.size() != mi->n_seq)
+      {
+        candidates.resize(mi->n_seq);
+        collectors.reserve(mi->n_seq);
+        slot.assign(mi->n_seq, -1);
+      }
+
+      std::size_t count = 0;
+      collectors.clear();
+      auto collector_of = [&](int rid) -> chainx::AnchorCollector&
+      {
+        if (slot[rid] < 0)
+        {
+          candidates[count].record = rid;
+          collectors.emplace_back(candidates[count].matches, transposed);
+          collectors.back().begin();
+          slot[rid] = count++;
+        }
+        return collectors[slot[rid]];
+      };
+
+      //a single record is always chained, even without anchors
+      if (!multi) collector_of(0);
+
+      std::size_t filtered = 0;   //minimizers above occurrence cap
+      for (std::size_t j = 0; j < minimizers.n; j++)
+      {
+        const mm128_t &m = minimizers.a[j];
+        int span = m.x & 0xff;
+        int qry = ((uint32_t)m.y >> 1) - span + 1;
+        int hits;
+        const uint64_t *cr = mm_idx_get(mi, m.x >> 8, &hits);
+        if (parameters.maxOcc > 0 && hits > parameters.maxOcc)
+        {
+          filtered++;
+          continue;
+        }
+        for (int h = 0; h < hits; h++)
+        {
+          if ((cr[h] & 1) != (m.y & 1)) continue;   //reverse complement match
+          int ref = ((uint32_t)cr[h] >> 1) - span + 1;
+          collector_of(cr[h] >> 32).add(ref, qry, span);
+        }
+      }
+
+      std::size_t anchor_count = 0;
+      for (std::size_t c = 0; c < count; c++)
+      {
+        //place last dummy anchor, sort if needed
+        collectors[c].end(mi->seq[candidates[c].record].len, len_qry, worker_sorter[t]);
+        anchor_count += candidates[c].matches.size();
+
+        if (VERBOSE)
+          log.err() << "List of sorted anchors = " << candidates[c].matches << "\n";
+      }
+
+      log.err() << "INFO, chainx-minimizer::main, " << (multi ? "target records with anchors = " + std::to_string(count) + ", " : "") \
+        << "count of anchors (including dummy) = " << anchor_count;
+      if (parameters.maxOcc > 0) log.err() << ", minimizers filtered by occurrence cap = " << filtered;
+      log.err() << "\n";
+
+      //records without anchors have a trivial chain of the two dummy anchors only; the shortest
+      //of them is the cheapest in global mode, semi-global mode needs one only if no record has anchors
+      std::size_t with_anchors = count;
+      if (multi && (!semiglobal || count == 0))
+      {
+        for (int rid : records_by_length)
+        {
+          if (slot[rid] >= 0) continue;
+
+          candidates[count].record = rid;
+          chainx::AnchorCollector collector (candidates[count].matches, transposed);
+          collector.begin();
+          collector.end(mi->seq[rid].len, len_qry, worker_sorter[t]);
+          count++;
+          break;
+        }
+      }
+      for (std::size_t c = 0; c < with_anchors; c++) slot[candidates[c].record] = -1;
+
+      //compute anchor-restricted edit distance
+      for (std::size_t c = 0; c < count; c++) candidates[c].anchors.assign(candidates[c].matches);
+      chainx::compute_lockstep(candidates.data(), count, semiglobal, parameters.incremental);
+
+      //best record, ties go to the first one
+      std::size_t best = 0;
+      for (std::size_t c = 1; c < count; c++)
+        if (std::make_tuple(candidates[c].cost, candidates[c].record) < std::make_tuple(candidates[best].cost, candidates[best].record))
+          best = c;
+
+      chainx::ChainCandidate &candidate = candidates[best];
+      const std::string tid = mi->seq[candidate.record].name;
+      log.err() << "INFO, chainx-minimizer::main, query #" << batch.first + i << " (" << len_qry << " residues), distance = " << candidate.cost << "\n";
+
+      if (parameters.chain)
+      {
+        std::vector<int> &chain = worker_chain[t];
+        chainx::trace_chain(candidate.anchors, semiglobal, chain);
+        chainx::write_paf(log.out(), query_ids[i], len_qry, tid, mi->seq[candidate.record].len, candidate.anchors, chain, transposed, semiglobal, candidate.cost);
+      }
+      else
+      {
+        log.out() << "distance = " << candidate.cost;
+        if (multi) log.out() << ", target = " << tid;
+        log.out() << "\n";
+      }
+
+      std::chrono::duration<double> wctduration = (std::chrono::system_clock::now() - tStart);
+      log.err() << "INFO, chainx-minimizer::main, distance computation finished (" << wctduration.count() << " seconds elapsed)\n";
+
+      output.emit(i, log);
+    });
+
+    queryCount += batch.size();
+    queryLenSum += batch.residues;
+    stream.release(next_batch);
+  }
+
+  writer.close();
+  std::cerr << "\nINFO, chainx-minimizer::main, processed " << queryCount << " queries, " << queryLenSum << " residues\n";
+
+  for (auto &minimizers : worker_minimizers) free(minimizers.a);
+  mm_idx_destroy(mi);
   return 0;
 }
@@ -6,6 +6,7 @@
 #include <zlib.h>  
 #include <string>
 #include <chrono>
+#include <memory>
 
 //third-party lib
 #include "mummer/sparseSA.hpp"
@@ -15,6 +16,13 @@
 //own includes
 #include "parseCmdArgs.hpp"
 #include "algo.hpp"
+#include "index.hpp"
+#include "align.hpp"
+#include "paf.hpp"
+#include "parallel.hpp"
+#include "target.hpp"
+#include "kmer_index.hpp"
+#include "filter.hpp"
 
 #undef VERBOSE
 #define VERBOSE 0
@@ -22,138 +30,469 @@
 int main(int argc, char **argv) 
 {
   chainx::Parameters parameters;
+
+  //chainX index -t <tpath> -i <index>
+  if (argc > 1 && std::string(argv[1]) == "index")
+  {
+    chainx::parseandSave_index(argc, argv, parameters);
+
+    std::vector<chainx::PackedSequence> target;
+    std::vector<std::string> target_ids;
+    chainx::readSequences(parameters.tfile, target, target_ids);
+    chainx::TargetSet targets (target, target_ids);
+    std::cerr << "INFO, chainx::main, read target, " << targets.residues() << " residues";
+    if (targets.size() > 1) std::cerr << " in " << targets.size() << " records";
+    std::cerr << "\n";
+
+    auto tStart = std::chrono::system_clock::now();
+    mummer::mummer::sparseSA sa (mummer::mummer::sparseSA::create_auto(targets.seq, parameters.minLen, true, parameters.sparseness, false, parameters.threads));
+
+    if (!chainx::save_index(sa, targets.seq, parameters.minLen, parameters.ifile))
+    {
+      std::cerr << "ERROR, chainx::main, index could not be written to " << parameters.ifile << "\n";
+      exit(1);
+    }
+
+    std::chrono::duration<double> wctduration = (std::chrono::system_clock::now() - tStart);
+    std::cerr << "INFO, chainx::main, suffix array computed and saved in " << wctduration.count() << " seconds\n";
+    std::cerr << "INFO, chainx::main, suffix array sparseness = " << sa.K << ", size = " << sa.index_size_in_bytes() << " bytes\n";
+    return 0;
+  }
+
   chainx::parseandSave_chainx(argc, argv, parameters);
 
-  std::vector<std::string> queries; //one or multiple sequences
+  std::vector<chainx::PackedSequence> queries; //one or multiple sequences, all2all mode only
   std::vector<std::string> query_ids;
-  std::vector<std::string> target; //single sequence
+  std::vector<chainx::PackedSequence> target; //one or multiple records
   std::vector<std::string> target_ids;
 
-  chainx::readSequences(parameters.qfile, queries, query_ids);
   chainx::readSequences(parameters.tfile, target, target_ids);
 
-  int queryLenSum = 0;
-  for (auto &q: queries) queryLenSum += q.length();
-  std::cerr << "INFO, chainx::main, read " << queries.size() << " queries, " << queryLenSum << " residues\n";
-  if (!parameters.all2all) std::cerr << "INFO, chainx::main, read target, " << target[0].length() << " residues\n";
+  //queries are streamed in batches unless all of them are needed at once
+  if (parameters.all2all)
+  {
+    chainx::readSequences(parameters.qfile, queries, query_ids);
+
+    int queryLenSum = 0;
+    for (auto &q: queries) queryLenSum += q.length();
+    std::cerr << "INFO, chainx::main, read " << queries.size() << " queries, " << queryLenSum << " residues\n";
+  }
 
   //Start timer
   auto tStart = std::chrono::system_clock::now();
   std::cerr << "\nINFO, chainx::main, timer set\n";
 
-  std::vector<std::tuple<int, int, int>> fwd_matches;
-  //lambda function
-  auto append_matches = [&](const mummer::mummer::match_t& m) { fwd_matches.emplace_back(m.ref, m.query, m.len); }; //0-based coordinates
-
   if (!parameters.all2all)
   {
-    //Compute anchors
-    mummer::mummer::sparseSA sa (mummer::mummer::sparseSA::create_auto(target[0].data(), target[0].length(), parameters.minLen, true));
+    //all target records are indexed together
+    chainx::TargetSet targets (target, target_ids);
+    std::cerr << "INFO, chainx::main, read target, " << targets.residues() << " residues";
+    if (targets.size() > 1) std::cerr << " in " << targets.size() << " records";
+    std::cerr << "\n";
+
+    //Compute anchors, short targets of A, C, G and T are indexed by a hash table of k-mers instead of a suffix array
+    chainx::MappedFile index_file;   //backs the suffix array when loaded with -i
+    std::unique_ptr<mummer::mummer::sparseSA> sa;
+    std::unique_ptr<chainx::KmerIndex> kmers;
+    if (parameters.ifile.empty() && parameters.sparseness == 1 && targets.seq.size() <= (std::size_t) parameters.kmerIndexMax
+        && targets.nucleotides_only())
+      kmers.reset(new chainx::KmerIndex(targets.seq, parameters.minLen));
+    else
+      sa.reset(new mummer::mummer::sparseSA(parameters.ifile.empty() ?
+          mummer::mummer::sparseSA::create_auto(targets.seq, parameters.minLen, true, parameters.sparseness, false, parameters.threads) :
+          chainx::load_index(parameters.ifile, targets.seq, parameters.minLen, parameters.sparseness, index_file)));
 
     std::chrono::duration<double> wctduration = (std::chrono::system_clock::now() - tStart);
-    std::cerr << "INFO, chainx::main, suffix array computed in " << wctduration.count() << " seconds\n";
+    if (kmers)
+    {
+      std::cerr << "INFO, chainx::main, k-mer index computed in " << wctduration.count() << " seconds\n";
+      std::cerr << "INFO, chainx::main, k-mer index size = " << kmers->index_size_in_bytes() << " bytes\n";
+    }
+    else
+    {
+      std::cerr << "INFO, chainx::main, suffix array " << (parameters.ifile.empty() ? "computed" : "loaded") << " in " << wctduration.count() << " seconds\n";
+      std::cerr << "INFO, chainx::main, suffix array sparseness = " << sa->K << ", size = " << sa->index_size_in_bytes() << " bytes\n";
+    }
+
+    //records in increasing order of length, to find the cheapest record without anchors
+    std::vector<int> records_by_length (targets.size());
+    for (std::size_t r = 0; r < targets.size(); r++) records_by_length[r] = r;
+    std::stable_sort(records_by_length.begin(), records_by_length.end(), [&](int x, int y) { return targets.lengths[x] < targets.lengths[y]; });
+
+    //per-worker buffers, the suffix array (or k-mer index) is shared read-only
+    std::vector<std::vector<chainx::ChainCandidate>> worker_candidates (parameters.threads);
+    std::vector<std::vector<std::tuple<int, int, int>>> worker_matches (parameters.threads);
+    std::vector<std::vector<int>> worker_slot (parameters.threads);
+    std::vector<std::vector<int>> worker_record_of (parameters.threads);
+    std::vector<std::vector<char>> worker_has_anchors (parameters.threads);
+    std::vector<std::vector<int>> worker_picked (parameters.threads);
+    std::vector<chainx::AnchorSorter> worker_sorter (parameters.threads);
+    std::vector<chainx::AnchorFilter> worker_filter (parameters.threads);
+    std::vector<std::vector<int>> worker_chain (parameters.threads);
+    std::vector<std::string> worker_rc (parameters.threads);
+    std::vector<std::string> worker_record (parameters.threads);
 
-    for (int i = 0; i < queries.size(); i++)
+    //pipeline: parsing thread -> worker threads (one batch at a time) -> output thread
+    chainx::SequenceStream stream (parameters.qfile);
+    chainx::OutputWriter writer;
+    std::size_t queryCount = 0, queryLenSum = 0;
+
+    while (chainx::SequenceBatch *next_batch = stream.next())
     {
-      std::cerr << "\nINFO, chainx::main, timer reset\n";
-      tStart = std::chrono::system_clock::now();
-      fwd_matches.clear();
-      if (parameters.matchType == "MEM")
-        sa.findMEM_each(queries[i].data(), queries[i].length(), parameters.minLen, false, append_matches);
-      else if (parameters.matchType == "MUM")
-        sa.findMUM_each(queries[i].data(), queries[i].length(), parameters.minLen, false, append_matches);
-      else
-        std::cerr << "ERROR, chainx::main, incorrect anchor type specified" << "\n";
-
-
-      wctduration = (std::chrono::system_clock::now() - tStart);
-      if (VERBOSE && parameters.matchType == "MEM") std::cerr << "INFO, chainx::main, MEMs identified (" << wctduration.count() << " seconds elapsed)\n";
-      if (VERBOSE && parameters.matchType == "MUM") std::cerr << "INFO, chainx::main, MUMs identified (" << wctduration.count() << " seconds elapsed)\n";
-
-      //place dummy MEMs and then sort
-      fwd_matches.emplace_back(-1,-1,1);
-      fwd_matches.emplace_back(target[0].length(), queries[i].length(), 1);
-      std::sort (fwd_matches.begin(), fwd_matches.end(),
-          [](const std::tuple<int,int,int>& a,
-            const std::tuple<int,int,int>& b) -> bool
+      const chainx::SequenceBatch &batch = *next_batch;
+      const std::vector<std::string> &queries = batch.seqs;
+      const std::vector<std::string> &query_ids = batch.ids;
+      chainx::OrderedOutput output (batch.size(), &writer);
+
+      chainx::parallel_for(batch.size(), parameters.threads, [&](int t, std::size_t i)
+      {
+        chainx::Transcript log;
+        int strands = parameters.bothStrands ? 2 : 1;
+        if (parameters.bothStrands) chainx::reverseComplement(queries[i], worker_rc[t]);
+        const std::string *strand_seq[2] = {&queries[i], &worker_rc[t]};
+        int len_qry = queries[i].length();
+        bool semiglobal = parameters.mode == "sg";
+        bool multi = targets.size() > 1;
+
+        //global distance is symmetric, MEMs are chained in query order as they are reported
+        bool transposed = parameters.matchType == "MEM" && parameters.mode == "g";
+
+        log.err() << "\nINFO, chainx::main, timer reset\n";
+        auto tStart = std::chrono::system_clock::now();
+        std::chrono::duration<double> wctduration;
+
+        //one candidate per strand and target record with anchors, buffers are reused across queries
+        std::vector<chainx::ChainCandidate> &candidates = worker_candidates[t];
+        std::size_t count = 0;
+        auto add_candidate = [&](int strand, int record)
+        {
+          if (count == candidates.size()) candidates.emplace_back();
+          candidates[count].strand = strand;
+          candidates[count].record = record;
+          return (int) count++;
+        };
+
+        //slot[r] = candidate of record r on current strand, -1 if none yet; reset after use
+        std::vector<int> &slot = worker_slot[t];
+        std::vector<char> &has_anchors = worker_has_anchors[t];
+        if (has_anchors.size() != targets.size()) has_anchors.assign(targets.size(), 0);
+
+        //anchors of reverse complement strand are found by a second scan of the same suffix array
+        for (int k = 0; k < strands; k++)
+        {
+          std::vector<std::tuple<int, int, int>> &raw = worker_matches[t];
+          const std::string &qseq = *strand_seq[k];
+
+          //lambda function
+          raw.clear();
+          auto append_matches = [&](const mummer::mummer::match_t& m) { raw.emplace_back(m.ref, m.query, m.len); }; //0-based coordinates
+
+          if (parameters.matchType == "MEM")
           {
-          return std::get<0>(a) < std::get<0>(b);
-          });
+            if (kmers) kmers->findMEM_each(qseq.data(), qseq.length(), parameters.minLen, false, append_matches);
+            else sa->findMEM_each(qseq.data(), qseq.length(), parameters.minLen, false, append_matches);
+          }
+          else if (parameters.matchType == "MUM")
+          {
+            if (kmers) kmers->findMUM_each(qseq.data(), qseq.length(), parameters.minLen, false, append_matches);
+            else sa->findMUM_each(qseq.data(), qseq.length(), parameters.minLen, false, append_matches);
+          }
+          else
+            log.err() << "ERROR, chainx::main, incorrect anchor type specified" << "\n";
 
-      std::size_t sum_anchor_len = 0;
-      for (auto &e: fwd_matches) sum_anchor_len += std::get<2>(e);
-      std::cerr << "INFO, chainx::main, count of anchors (including dummy) = " << fwd_matches.size() << ", average length = " << sum_anchor_len * 1.0 / fwd_matches.size() << "\n";
+          //drop anchors of repeats before they reach the chaining engine
+          std::size_t capped = worker_filter[t].cap_occurrences(raw, qseq.length(), parameters.maxOcc);
+          std::size_t masked = worker_filter[t].mask_low_complexity(raw, qseq, parameters.sdust);
 
-      if (VERBOSE)
-        std::cerr << "List of sorted anchors = " << fwd_matches << "\n";
+          wctduration = (std::chrono::system_clock::now() - tStart);
+          if (VERBOSE && parameters.matchType == "MEM") log.err() << "INFO, chainx::main, MEMs identified (" << wctduration.count() << " seconds elapsed)\n";
+          if (VERBOSE && parameters.matchType == "MUM") log.err() << "INFO, chainx::main, MUMs identified (" << wctduration.count() << " seconds elapsed)\n";
 
-      //compute anchor-restricted edit distance
-      std::cerr << "INFO, chainx::main, query #" << i << " (" << queries[i].length() << " residues), ";
-      if (parameters.mode == "g")
-      {
-        if (parameters.naive)
-          std::cout << "distance = " << chainx::DP_global(fwd_matches) << "\n";
-        else
-          std::cout << "distance = " << chainx::compute_global(fwd_matches) << "\n";
-      }
-      else if (parameters.mode == "sg")
-      {
-        if (parameters.naive)
-          std::cout << "distance = " << chainx::DP_semiglobal(fwd_matches) << "\n";
+          //split anchors by target record, keeping their order, and map them to record coordinates
+          //a single record is always chained, even without anchors
+          std::size_t first = count;
+          if (slot.size() != targets.size()) slot.assign(targets.size(), -1);
+          if (!multi) slot[0] = add_candidate(k, 0);
+          std::vector<int> &record_of = worker_record_of[t];
+          record_of.resize(raw.size());
+          for (std::size_t e = 0; e < raw.size(); e++)
+          {
+            int r = multi ? targets.locate(std::get<0>(raw[e])) : 0;
+            if (slot[r] < 0) slot[r] = add_candidate(k, r);
+            record_of[e] = r;
+          }
+
+          std::vector<chainx::AnchorCollector> collectors;
+          collectors.reserve(count - first);
+          for (std::size_t c = first; c < count; c++)
+          {
+            collectors.emplace_back(candidates[c].matches, transposed);
+            collectors.back().begin();
+          }
+          for (std::size_t e = 0; e < raw.size(); e++)
+          {
+            int r = record_of[e];
+            collectors[slot[r] - first].add(std::get<0>(raw[e]) - targets.starts[r], std::get<1>(raw[e]), std::get<2>(raw[e]));
+          }
+
+          std::size_t anchor_count = 0, sum_anchor_len = 0;
+          for (std::size_t c = first; c < count; c++)
+          {
+            //place last dummy MEM, sort if needed
+            collectors[c - first].end(targets.lengths[candidates[c].record], len_qry, worker_sorter[t]);
+
+            anchor_count += candidates[c].matches.size();
+            for (auto &e: candidates[c].matches) sum_anchor_len += std::get<2>(e);
+
+            if (VERBOSE)
+              log.err() << "List of sorted anchors = " << candidates[c].matches << "\n";
+
+            slot[candidates[c].record] = -1;
+            has_anchors[candidates[c].record] = 1;
+          }
+
+          log.err() << "INFO, chainx::main, " << (parameters.bothStrands ? (k ? "strand -, " : "strand +, ") : "") \
+            << (multi ? "target records with anchors = " + std::to_string(count - first) + ", " : "") \
+            << "count of anchors (including dummy) = " << anchor_count << ", average length = " << sum_anchor_len * 1.0 / anchor_count;
+          if (parameters.maxOcc > 0 || parameters.sdust > 0)
+            log.err() << ", filtered = " << capped + masked << " (" << capped << " by occurrence cap, " << masked << " low-complexity)";
+          log.err() << "\n";
+        }
+
+        //records without anchors have a trivial chain of the two dummy anchors only, with cost
+        //max(query, record length) in global mode and query length in semi-global mode; they are
+        //chained only if they can be reported: all within --max-distance, otherwise the cheapest one
+        if (multi)
+        {
+          std::size_t with_anchors = count;
+          for (int r : records_by_length)
+          {
+            if (has_anchors[r]) continue;
+            int trivial = semiglobal ? len_qry : std::max(len_qry, targets.lengths[r]);
+            if (parameters.maxDistance >= 0 ? trivial > parameters.maxDistance : (semiglobal && with_anchors > 0))
+              break;
+
+            chainx::AnchorCollector collector (candidates[add_candidate(0, r)].matches, transposed);
+            collector.begin();
+            collector.end(targets.lengths[r], len_qry, worker_sorter[t]);
+            if (parameters.maxDistance < 0) break;
+          }
+
+          for (std::size_t c = 0; c < with_anchors; c++) has_anchors[candidates[c].record] = 0;
+        }
+
+        //compute anchor-restricted edit distance
+        log.err() << "INFO, chainx::main, query #" << batch.first + i << " (" << len_qry << " residues), ";
+        bool trace = parameters.chain || (parameters.exact && !parameters.naive);   //optimal chain is needed later
+        if (parameters.naive || parameters.rmq)
+        {
+          for (std::size_t c = 0; c < count; c++)
+          {
+            std::vector<std::tuple<int, int, int>> &fwd_matches = candidates[c].matches;
+            chainx::AnchorSet &anchors = candidates[c].anchors;
+            candidates[c].exact = true;
+            if (parameters.naive)
+              candidates[c].cost = semiglobal ? chainx::DP_semiglobal(fwd_matches) : chainx::DP_global(fwd_matches);
+            else
+            {
+              chainx::AnchorSet *trace_out = trace ? &anchors : NULL;
+              candidates[c].cost = semiglobal ? chainx::compute_semiglobal_rmq(fwd_matches, trace_out) : chainx::compute_global_rmq(fwd_matches, trace_out);
+            }
+          }
+        }
         else
-          std::cout << "distance = " << chainx::compute_semiglobal(fwd_matches) << "\n";
-      }
-      else
-        std::cerr << "ERROR, chainx::main, incorrect mode specified" << "\n";
+        {
+          for (std::size_t c = 0; c < count; c++) candidates[c].anchors.assign(candidates[c].matches);
+          chainx::compute_lockstep(candidates.data(), count, semiglobal, parameters.incremental, parameters.maxDistance);
+        }
+
+        if (strands == 2 && !multi)
+          log.err() << "strand + cost " << (candidates[0].exact ? "= " : ">= ") << candidates[0].cost \
+            << ", strand - cost " << (candidates[1].exact ? "= " : ">= ") << candidates[1].cost << ", ";
+
+        //candidates to report: the best one, or all within --max-distance by increasing cost;
+        //ties go to the forward strand and the first record
+        std::vector<int> &picked = worker_picked[t];
+        picked.clear();
+        for (std::size_t c = 0; c < count; c++)
+          if (parameters.maxDistance < 0 || (candidates[c].exact && candidates[c].cost <= parameters.maxDistance))
+            picked.push_back(c);
+        std::stable_sort(picked.begin(), picked.end(), [&](int x, int y)
+        {
+          const chainx::ChainCandidate &a = candidates[x], &b = candidates[y];
+          return std::make_tuple(a.cost, a.strand, a.record) < std::make_tuple(b.cost, b.strand, b.record);
+        });
+        if (parameters.maxDistance < 0) picked.resize(1);
+
+        if (picked.empty())
+          log.err() << "no target record within distance " << parameters.maxDistance << "\n";
 
+        for (int c : picked)
+        {
+          //rest of the pipeline works on the chosen strand and record
+          chainx::ChainCandidate &candidate = candidates[c];
+          int distance = candidate.cost;
+          int strand = candidate.strand;
+          const std::string &qseq = *strand_seq[strand];
+          chainx::AnchorSet &anchors = candidate.anchors;
+          const std::string &tid = targets.ids[candidate.record];
+          int len_ref = targets.lengths[candidate.record];
+
+          if (parameters.chain)
+          {
+            //distance goes to stderr, chain to stdout
+            std::vector<int> &chain = worker_chain[t];
+            chainx::trace_chain(anchors, semiglobal, chain);
+            log.err() << "distance = " << distance << ", chained anchors = " << chain.size() << "\n";
+            if (parameters.align)
+            {
+              //gaps are split among the threads left over from the query loop
+              chainx::ChainAlignment aln;
+              int gap_threads = std::max<int>(1, parameters.threads / batch.size());
+              const std::string &tseq = targets.record(candidate.record, worker_record[t]);
+              chainx::align_chain(qseq, tseq, anchors, chain, transposed, semiglobal, gap_threads, aln);
+              chainx::write_paf(log.out(), query_ids[i], qseq.length(), tid, len_ref, anchors, chain, transposed, semiglobal, distance, &aln, strand == 1);
+            }
+            else
+              chainx::write_paf(log.out(), query_ids[i], qseq.length(), tid, len_ref, anchors, chain, transposed, semiglobal, distance, NULL, strand == 1);
+          }
+          else if (parameters.exact)
+          {
+            //an alignment along the optimal chain bounds the edit distance from above, and is
+            //usually much tighter than the chaining cost; without a chain, fall back to the cost
+            const std::string &tseq = targets.record(candidate.record, worker_record[t]);
+            int k = chainx::band_from_cost(distance), tries;
+            if (trace)
+            {
+              std::vector<int> &chain = worker_chain[t];
+              chainx::ChainAlignment aln;
+              chainx::trace_chain(anchors, semiglobal, chain);
+              chainx::align_chain(qseq, tseq, anchors, chain, transposed, semiglobal, 1, aln);
+              k = aln.edit_distance;
+            }
 
-      wctduration = (std::chrono::system_clock::now() - tStart);
-      std::cerr << "INFO, chainx::main, distance computation finished (" << wctduration.count() << " seconds elapsed)\n";
+            //chaining cost goes to stderr, exact distance to stdout
+            int exact = chainx::banded_edit_distance(qseq, tseq, semiglobal, k, tries);
+            log.err() << "chaining cost = " << distance << ", edlib band = " << k << ", edlib calls = " << tries << "\n";
+            if (parameters.maxDistance >= 0) log.out() << "query = " << query_ids[i] << ", ";
+            log.out() << "distance = " << exact;
+            if (strands == 2) log.out() << ", strand = " << (strand ? "-" : "+");
+            if (multi) log.out() << ", target = " << tid;
+            log.out() << "\n";
+          }
+          else
+          {
+            //several lines per query with --max-distance, each names its query
+            if (parameters.maxDistance >= 0) log.out() << "query = " << query_ids[i] << ", ";
+            log.out() << "distance = " << distance;
+            if (strands == 2) log.out() << ", strand = " << (strand ? "-" : "+");
+            if (multi) log.out() << ", target = " << tid;
+            log.out() << "\n";
+          }
+        }
+
+        //report work done by each pass of the bound-doubling loop
+        if (!parameters.naive && !parameters.rmq && !picked.empty())
+        {
+          chainx::RevisionStats &revision_stats = candidates[picked[0]].stats;
+          for (std::size_t k = 0; k < revision_stats.bounds.size(); k++)
+            log.err() << "INFO, chainx::main, chaining pass #" << k << ", bound = " << revision_stats.bounds[k] \
+              << ", predecessor pairs examined = " << revision_stats.pairs[k] \
+              << ", anchors updated = " << revision_stats.updated[k] << "\n";
+        }
+
+        wctduration = (std::chrono::system_clock::now() - tStart);
+        log.err() << "INFO, chainx::main, distance computation finished (" << wctduration.count() << " seconds elapsed)\n";
+
+        output.emit(i, log);
+      });
+
+      queryCount += batch.size();
+      queryLenSum += batch.residues;
+      stream.release(next_batch);
     }
+
+    writer.close();
+    std::cerr << "\nINFO, chainx::main, processed " << queryCount << " queries, " << queryLenSum << " residues\n";
   }
   else
   {
     std::vector<std::vector<int>> costs (queries.size());
     for(std::size_t i = 0; i < queries.size(); i++) costs[i] = std::vector<int>(queries.size(), -1);
 
-    for (std::size_t i = 0; i < queries.size(); i++)
+    //per-worker anchor buffers
+    std::vector<std::vector<std::tuple<int, int, int>>> worker_matches (parameters.threads);
+    std::vector<chainx::AnchorSet> worker_anchors (parameters.threads);
+    std::vector<chainx::AnchorSorter> worker_sorter (parameters.threads);
+    std::vector<std::string> worker_qry (parameters.threads);
+
+    //rows are processed in blocks, at most 'maxIndexes' suffix arrays are alive at once
+    const std::size_t block = parameters.maxIndexes;
+    const std::size_t tile = 16;   //columns per scheduled task
+
+    for (std::size_t r0 = 0; r0 < queries.size(); r0 += block)
     {
-      //build SA of queries[i]
-      mummer::mummer::sparseSA sa = mummer::mummer::sparseSA::create_auto(queries[i].data(), queries[i].length(), parameters.minLen, true);
+      std::size_t r1 = std::min(queries.size(), r0 + block);
 
-      for (std::size_t j = 0; j < i; j++)
+      //build SAs of queries[r0..r1) concurrently, threads left over are shared among them
+      std::vector<std::unique_ptr<mummer::mummer::sparseSA>> sa (r1 - r0);
+      int sa_threads = std::max<int>(1, parameters.threads / (r1 - r0));
+      chainx::parallel_for(r1 - r0, parameters.threads, [&](int, std::size_t k)
       {
-        //compute costs[i][j] && costs[j][i]
+        sa[k].reset(new mummer::mummer::sparseSA(mummer::mummer::sparseSA::create_auto(queries[r0 + k], parameters.minLen, true, parameters.sparseness, false, sa_threads)));
+      });
 
-        fwd_matches.clear();
-        if (parameters.matchType == "MEM")
-          sa.findMEM_each(queries[j].data(), queries[j].length(), parameters.minLen, false, append_matches);
-        else if (parameters.matchType == "MUM")
-          sa.findMUM_each(queries[j].data(), queries[j].length(), parameters.minLen, false, append_matches);
-        else
+      //list (i, [j0, j1)) tiles covering all pairs j < i of this block
+      std::vector<std::tuple<std::size_t, std::size_t, std::size_t>> tiles;
+      for (std::size_t i = r0; i < r1; i++)
+        for (std::size_t j0 = 0; j0 < i; j0 += tile)
+          tiles.emplace_back(i, j0, std::min(i, j0 + tile));
+
+      chainx::parallel_for(tiles.size(), parameters.threads, [&](int t, std::size_t k)
+      {
+        std::size_t i = std::get<0>(tiles[k]);
+        std::vector<std::tuple<int, int, int>> &fwd_matches = worker_matches[t];
+
+        //global distance is symmetric, MEMs are chained in query order as they are reported
+        chainx::AnchorCollector collector (fwd_matches, parameters.matchType == "MEM");
+
+        //lambda function
+        auto append_matches = [&](const mummer::mummer::match_t& m) { collector.add(m.ref, m.query, m.len); }; //0-based coordinates
+
+        for (std::size_t j = std::get<1>(tiles[k]); j < std::get<2>(tiles[k]); j++)
         {
-          std::cerr << "ERROR, chainx::main, incorrect anchor type specified" << "\n";
-          exit(1);
-        }
+          //compute costs[i][j] && costs[j][i]
+          //sequences are kept packed, query side is unpacked for the suffix array search
+          std::string &qry = worker_qry[t];
+          queries[j].unpack(0, queries[j].size(), qry);
 
-        //place dummy MEMs and then sort
-        fwd_matches.emplace_back(-1,-1,1);
-        fwd_matches.emplace_back(queries[i].length(), queries[j].length(), 1);
-        std::sort (fwd_matches.begin(), fwd_matches.end(),
-            [](const std::tuple<int,int,int>& a,
-              const std::tuple<int,int,int>& b) -> bool
-            {
-            return std::get<0>(a) < std::get<0>(b);
-            });
+          collector.begin();
+          if (parameters.matchType == "MEM")
+            sa[i - r0]->findMEM_each(qry.data(), qry.length(), parameters.minLen, false, append_matches);
+          else if (parameters.matchType == "MUM")
+            sa[i - r0]->findMUM_each(qry.data(), qry.length(), parameters.minLen, false, append_matches);
+          else
+          {
+            std::cerr << "ERROR, chainx::main, incorrect anchor type specified" << "\n";
+            exit(1);
+          }
 
-        if (parameters.naive)
-          costs[j][i] = costs[i][j] = chainx::DP_global(fwd_matches);
-        else
-          costs[j][i] = costs[i][j] = chainx::compute_global(fwd_matches);
+          //place last dummy MEM, sort if needed
+          collector.end(queries[i].length(), queries[j].length(), worker_sorter[t]);
 
-      }
+          if (parameters.naive)
+            costs[j][i] = costs[i][j] = chainx::DP_global(fwd_matches);
+          else if (parameters.rmq)
+            costs[j][i] = costs[i][j] = chainx::compute_global_rmq(fwd_matches);
+          else
+          {
+            worker_anchors[t].assign(fwd_matches);
+            costs[j][i] = costs[i][j] = chainx::compute_global(worker_anchors[t], parameters.incremental);
+          }
+        }
+      });
 
-      costs[i][i] = 0;
+      for (std::size_t i = r0; i < r1; i++) costs[i][i] = 0;
     }
 
     std::cerr << "\nINFO, chainx::main, printing distance matrix to stdout\n";
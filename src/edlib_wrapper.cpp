@@ -16,6 +16,7 @@
 //own includes
 #include "parseCmdArgs.hpp"
 #include "algo.hpp"
+#include "parallel.hpp"
 
 #undef VERBOSE
 #define VERBOSE 0
@@ -25,18 +26,24 @@ int main(int argc, char **argv)
   chainx::Parameters parameters;
   chainx::parseandSave_edlib(argc, argv, parameters);
 
-  std::vector<std::string> queries; //one or multiple sequences
+  std::vector<std::string> queries; //one or multiple sequences, all2all mode only
   std::vector<std::string> query_ids;
   std::vector<std::string> target; //single sequence
   std::vector<std::string> target_ids;
 
-  chainx::readSequences(parameters.qfile, queries, query_ids);
   chainx::readSequences(parameters.tfile, target, target_ids);
 
-  int queryLenSum = 0;
-  for (auto &q: queries) queryLenSum += q.length();
-  std::cerr << "INFO, chainx::main, read " << queries.size() << " queries, " << queryLenSum << " residues\n";
-  if (!parameters.all2all) std::cerr << "INFO, chainx::main, read target, " << target[0].length() << " residues\n";
+  //queries are streamed in batches unless all of them are needed at once
+  if (parameters.all2all)
+  {
+    chainx::readSequences(parameters.qfile, queries, query_ids);
+
+    int queryLenSum = 0;
+    for (auto &q: queries) queryLenSum += q.length();
+    std::cerr << "INFO, chainx::main, read " << queries.size() << " queries, " << queryLenSum << " residues\n";
+  }
+  else
+    std::cerr << "INFO, chainx::main, read target, " << target[0].length() << " residues\n";
 
   //Start timer
   auto tStart = std::chrono::system_clock::now();
@@ -44,57 +51,89 @@ int main(int argc, char **argv)
 
   if (!parameters.all2all)
   {
-    for (int i = 0; i < queries.size(); i++)
+    chainx::SequenceReader reader (parameters.qfile);
+    chainx::SequenceBatch batch;
+    std::size_t queryCount = 0, queryLenSum = 0;
+
+    while (reader.next(batch))
     {
-      //Start timer
-      std::cerr << "\nINFO, chainx::main, timer reset\n";
-      auto tStart = std::chrono::system_clock::now();
+      const std::vector<std::string> &queries = batch.seqs;
+      chainx::OrderedOutput output (batch.size());
+
+      //longest queries of batch first, output stays in input order
+      std::vector<std::size_t> order (batch.size());
+      for (std::size_t i = 0; i < order.size(); i++) order[i] = i;
+      std::stable_sort(order.begin(), order.end(), [&](std::size_t x, std::size_t y) { return queries[x].length() > queries[y].length(); });
 
-      //compute edit distance
-      std::cout << "INFO, chainx::main, query #" << i << " (" << queries[i].length() << " residues), ";
-      if (parameters.mode == "g")
+      chainx::parallel_for(order.size(), parameters.threads, [&](int, std::size_t k)
       {
-        EdlibAlignResult result = edlibAlign(queries[i].data(), queries[i].length(), target[0].data(), target[0].length(), edlibDefaultAlignConfig());
-        if (result.status == EDLIB_STATUS_OK) {
-          std::cout << "distance = " << result.editDistance << "\n";
+        std::size_t i = order[k];
+        chainx::Transcript log;
+
+        //Start timer
+        log.err() << "\nINFO, chainx::main, timer reset\n";
+        auto tStart = std::chrono::system_clock::now();
+
+        //compute edit distance
+        log.out() << "INFO, chainx::main, query #" << batch.first + i << " (" << queries[i].length() << " residues), ";
+        if (parameters.mode == "g")
+        {
+          EdlibAlignResult result = edlibAlign(queries[i].data(), queries[i].length(), target[0].data(), target[0].length(), edlibDefaultAlignConfig());
+          if (result.status == EDLIB_STATUS_OK) {
+            log.out() << "distance = " << result.editDistance << "\n";
+          }
+          edlibFreeAlignResult(result);
         }
-        edlibFreeAlignResult(result);
-      }
-      else if (parameters.mode == "sg")
-      {
-        EdlibAlignResult result = edlibAlign(queries[i].data(), queries[i].length(), target[0].data(), target[0].length(),
-            edlibNewAlignConfig(-1, EDLIB_MODE_HW, EDLIB_TASK_DISTANCE, NULL, 0));
-        if (result.status == EDLIB_STATUS_OK) {
-          std::cout << "distance = " << result.editDistance << "\n";
+        else if (parameters.mode == "sg")
+        {
+          EdlibAlignResult result = edlibAlign(queries[i].data(), queries[i].length(), target[0].data(), target[0].length(),
+              edlibNewAlignConfig(-1, EDLIB_MODE_HW, EDLIB_TASK_DISTANCE, NULL, 0));
+          if (result.status == EDLIB_STATUS_OK) {
+            log.out() << "distance = " << result.editDistance << "\n";
+          }
+          edlibFreeAlignResult(result);
         }
-      }
-      else
-        std::cerr << "ERROR, chainx::main, incorrect mode specified" << "\n";
+        else
+          log.err() << "ERROR, chainx::main, incorrect mode specified" << "\n";
+
 
+        std::chrono::duration<double> wctduration = (std::chrono::system_clock::now() - tStart);
+        log.err() << "INFO, chainx::main, distance computation finished (" << wctduration.count() << " seconds elapsed)\n";
+        output.emit(i, log);
+      });
 
-      std::chrono::duration<double> wctduration = (std::chrono::system_clock::now() - tStart);
-      std::cerr << "INFO, chainx::main, distance computation finished (" << wctduration.count() << " seconds elapsed)\n";
+      queryCount += batch.size();
+      queryLenSum += batch.residues;
     }
+
+    std::cerr << "\nINFO, chainx::main, processed " << queryCount << " queries, " << queryLenSum << " residues\n";
   }
   else
   {
     std::vector<std::vector<int>> costs (queries.size());
     for(std::size_t i = 0; i < queries.size(); i++) costs[i] = std::vector<int>(queries.size(), -1);
+    for(std::size_t i = 0; i < queries.size(); i++) costs[i][i] = 0;
 
+    //pairs in decreasing order of work, i.e., length product, so that the longest
+    //alignments do not end up last on one thread
+    std::vector<std::pair<std::size_t, std::size_t>> pairs;
     for (std::size_t i = 0; i < queries.size(); i++)
-    {
       for (std::size_t j = 0; j < i; j++)
-      {
-        //compute costs[i][j] && costs[j][i]
-        EdlibAlignResult result = edlibAlign(queries[i].data(), queries[i].length(), queries[j].data(), queries[j].length(), edlibDefaultAlignConfig());
-        if (result.status == EDLIB_STATUS_OK) {
-          costs[j][i] = costs[i][j] = result.editDistance;
-        }
-        edlibFreeAlignResult(result);
-      }
+        pairs.emplace_back(i, j);
+    auto work = [&](const std::pair<std::size_t, std::size_t> &p) { return (uint64_t) queries[p.first].length() * queries[p.second].length(); };
+    std::stable_sort(pairs.begin(), pairs.end(), [&](const std::pair<std::size_t, std::size_t> &x, const std::pair<std::size_t, std::size_t> &y) { return work(x) > work(y); });
 
-      costs[i][i] = 0;
-    }
+    chainx::parallel_for(pairs.size(), parameters.threads, [&](int, std::size_t k)
+    {
+      std::size_t i = pairs[k].first, j = pairs[k].second;
+
+      //compute costs[i][j] && costs[j][i]
+      EdlibAlignResult result = edlibAlign(queries[i].data(), queries[i].length(), queries[j].data(), queries[j].length(), edlibDefaultAlignConfig());
+      if (result.status == EDLIB_STATUS_OK) {
+        costs[j][i] = costs[i][j] = result.editDistance;
+      }
+      edlibFreeAlignResult(result);
+    });
 
     std::cerr << "\nINFO, chainx::main, printing distance matrix to stdout\n";
 
@@ -9,6 +9,12 @@
 #include <zlib.h>  
 #include <string>
 #include <chrono>
+#include <limits>
+#include <cstdint>
+
+#include "anchors.hpp"
+#include "kernel.hpp"
+#include "rmq.hpp"
 
 #undef VERBOSE
 #define VERBOSE 0
@@ -16,61 +22,161 @@
 namespace chainx
 {
   /**
-   * @brief   compute anchor-restricted edit distance using strong precedence criteria
-   * 			    optimized to run faster using engineering trick(s), comparison mode: global
+   * @brief   work done by each pass of the bound-doubling chaining loop
    **/
-  int compute_global(const std::vector<std::tuple<int, int, int>> &anchors)
+  struct RevisionStats
   {
-    int n = anchors.size();
-    std::vector<int> costs(n, 0);
+    std::vector<int> bounds;        //distance bound assumed in each pass
+    std::vector<long> pairs;        //count of predecessor pairs examined in each pass
+    std::vector<int> updated;       //count of anchors whose cost was (re)computed in each pass
 
-    int bound_redit = 100; //distance assumed to be <= 100
-    int revisions = 0;
-    //with this assumption on upper bound of distance, a gap of >bound_redit will not be allowed between adjacent anchors
+    void clear() { bounds.clear(); pairs.clear(); updated.clear(); }
+  };
 
-    while (true) 
+  /**
+   * @brief   revise costs after the distance bound is raised from prev_bound to bound,
+   *          reusing costs of the previous pass
+   *          for each anchor only the newly admitted predecessors (reference gap between
+   *          prev_bound and bound) and the predecessors whose cost improved in this pass are
+   *          examined; this yields the same costs as a full pass with the larger bound
+   **/
+  void revise_bound(AnchorSet &s, int prev_bound, int bound, bool semiglobal, RevisionStats *stats)
+  {
+    int n = s.n;
+    aligned_ivec &costs = s.cost;
+
+    std::vector<int> improved;      //anchors whose cost decreased in this pass, in increasing order
+    std::size_t improved_start = 0;
+    long pairs = 0;
+
+    int old_start = 0, new_start = 0;
+
+    for(int j=1; j<n; j++)
     {
-      int inner_loop_start = 0;
+      while (s.a[j] - s.a[new_start] - 1 > bound)
+        new_start++;
+      while (s.a[j] - s.a[old_start] - 1 > prev_bound)
+        old_start++;
 
-      for(int j=1; j<n; j++)
+      //semi-global mode considers all anchors for the final last dummy anchor in every pass
+      bool last = semiglobal && j == n-1;
+      int lo = last ? 0 : new_start;
+      int hi = last ? 0 : old_start;
+
+      //previous cost already accounts for unchanged predecessors in the old window
+      int find_min_cost = costs[j];
+
+      if (lo < hi)
       {
-        //compute cost[i] here
-        int find_min_cost = std::numeric_limits<int>::max();
+        find_min_cost = std::min(find_min_cost, min_predecessor_cost(s, lo, hi, j, false));
+        pairs += hi - lo;
+      }
 
-        int j_a = std::get<0>(anchors[j]);
-        int j_b = std::get<0>(anchors[j]) + std::get<2>(anchors[j]) - 1;
-        int j_c = std::get<1>(anchors[j]);
-        int j_d = std::get<1>(anchors[j]) + std::get<2>(anchors[j]) - 1;
+      //improved predecessors within the old window
+      while (improved_start < improved.size() && improved[improved_start] < old_start)
+        improved_start++;
+      std::size_t first = last ? 0 : improved_start;
+      for(std::size_t k = first; k < improved.size(); k++)
+        find_min_cost = std::min(find_min_cost, predecessor_cost(s, improved[k], j, last));
+      pairs += improved.size() - first;
 
-        // anchor i < anchor j 
+      if (find_min_cost < costs[j])
+      {
+        costs[j] = find_min_cost;
+        improved.push_back(j);
+      }
+    }
 
-        while (j_a - std::get<0>(anchors[inner_loop_start]) - 1 > bound_redit)
-          inner_loop_start++;
+    if (stats)
+    {
+      stats->bounds.push_back(bound);
+      stats->pairs.push_back(pairs);
+      stats->updated.push_back(improved.size());
+    }
+  }
 
-        for(int i=j-1; i>=inner_loop_start; i--)
-        {
-          int i_a = std::get<0>(anchors[i]);
-          int i_b = std::get<0>(anchors[i]) + std::get<2>(anchors[i]) - 1;
-          int i_c = std::get<1>(anchors[i]);
-          int i_d = std::get<1>(anchors[i]) + std::get<2>(anchors[i]) - 1;
+  /**
+   * @brief   one pass of the bound-doubling chaining loop with distance bound 'bound':
+   *          a gap of >bound is not allowed between adjacent anchors
+   *          if revise is set, costs of the previous pass with bound 'prev_bound' are reused
+   **/
+  void chaining_pass(AnchorSet &s, int prev_bound, int bound, bool semiglobal, bool revise, RevisionStats *stats)
+  {
+    if (revise)
+    {
+      revise_bound(s, prev_bound, bound, semiglobal, stats);
+      return;
+    }
 
-          if (costs[i] < std::numeric_limits<int>::max() && i_a < j_a && i_b < j_b && i_c < j_c && i_d < j_d)
-          {
-            int gap1 = std::max(0, j_a - i_b - 1);
-            int gap2 = std::max(0, j_c - i_d - 1);
-            int g = std::max(gap1,gap2);
+    int n = s.n;
+    aligned_ivec &costs = s.cost;
+    int inner_loop_start = 0;
+    long pairs = 0;
 
-            int overlap1 = std::max(0, i_b - j_a + 1);
-            int overlap2 = std::max(0, i_d - j_c + 1);
-            int o = std::abs(overlap1 - overlap2);
+    for(int j=1; j<n; j++)
+    {
+      // anchor i < anchor j 
 
-            find_min_cost = std::min(find_min_cost, costs[i] + g + o);
-          }
-        }
+      while (s.a[j] - s.a[inner_loop_start] - 1 > bound)
+        inner_loop_start++;
+
+      if (!semiglobal)
+      {
         //save optimal cost at offset j
-        costs[j] = find_min_cost;
+        costs[j] = min_predecessor_cost(s, inner_loop_start, j, j, false);
+        pairs += j - inner_loop_start;
+        continue;
       }
 
+      //compute cost[i] here
+      int find_min_cost = std::numeric_limits<int>::max();
+
+      {
+        //always consider the first dummy anchor 
+        //connection to first dummy anchor is done with modified cost to allow free gaps
+        int qry_gap = s.c[j] - s.d[0] - 1;
+        find_min_cost = std::min(find_min_cost, costs[0] + qry_gap);
+      }
+
+      //process all anchors in array for the final last dummy anchor
+      //modified cost for the last dummy anchor to allow free gaps
+      int lo = (j == n-1) ? 0 : inner_loop_start;
+
+      find_min_cost = std::min(find_min_cost, min_predecessor_cost(s, lo, j, j, j == n-1));
+      pairs += j - lo;
+
+      //save optimal cost at offset j
+      costs[j] = find_min_cost;
+    }
+
+    if (stats)
+    {
+      stats->bounds.push_back(bound);
+      stats->pairs.push_back(pairs);
+      stats->updated.push_back(n-1);
+    }
+  }
+
+  /**
+   * @brief   compute anchor-restricted edit distance using strong precedence criteria
+   * 			    optimized to run faster using engineering trick(s), comparison mode: global
+   *          if incremental is set, passes after the first reuse costs of the previous pass
+   **/
+  int compute_global(AnchorSet &s, bool incremental = false, RevisionStats *stats = NULL)
+  {
+    int n = s.n;
+    aligned_ivec &costs = s.cost;
+
+    int bound_redit = 100; //distance assumed to be <= 100
+    int revisions = 0;
+    //with this assumption on upper bound of distance, a gap of >bound_redit will not be allowed between adjacent anchors
+
+    if (stats) stats->clear();
+
+    while (true) 
+    {
+      chaining_pass(s, bound_redit / 4, bound_redit, false, incremental && revisions > 0, stats);
+
       if (costs[n-1] > bound_redit)
       {
         bound_redit = bound_redit * 4;
@@ -81,153 +187,449 @@ namespace chainx
     }
 
     if (VERBOSE)
-      std::cerr << "Cost array = " << costs << "\n";
+      std::cerr << "Cost array = " << std::vector<int>(costs.begin(), costs.end()) << "\n";
 
     if (VERBOSE)
       std::cerr << "Chaining cost computed " << revisions + 1 << " times" << "\n";
     return costs[n-1];
   }
 
+  int compute_global(const std::vector<std::tuple<int, int, int>> &anchors, bool incremental = false, RevisionStats *stats = NULL)
+  {
+    AnchorSet s;
+    s.assign(anchors);
+    return compute_global(s, incremental, stats);
+  }
+
   /**
    * @brief   compute anchor-restricted (semi-global) edit distance using strong precedence criteria
    * 			    optimized to run faster using engineering trick(s)
+   *          if incremental is set, passes after the first reuse costs of the previous pass
    **/
-  int compute_semiglobal(const std::vector<std::tuple<int, int, int>> &anchors)
+  int compute_semiglobal(AnchorSet &s, bool incremental = false, RevisionStats *stats = NULL)
   {
-    int n = anchors.size();
-    std::vector<int> costs(n, 0);
+    int n = s.n;
+    aligned_ivec &costs = s.cost;
 
     int bound_redit = 100; //distance assumed to be <= 100
     int revisions = 0;
     //with this assumption on upper bound of distance, a gap of >bound_redit will not be allowed between adjacent anchors
 
+    if (stats) stats->clear();
+
     while (true) 
     {
-      int inner_loop_start = 0;
+      chaining_pass(s, bound_redit / 4, bound_redit, true, incremental && revisions > 0, stats);
+
+      if (costs[n-1] > bound_redit)
+      {
+        bound_redit = bound_redit * 4;
+        revisions++;
+      }
+      else
+        break;
+    }
+
+    if (VERBOSE)
+      std::cerr << "Cost array = " << std::vector<int>(costs.begin(), costs.end()) << "\n";
+
+    if (VERBOSE)
+      std::cerr << "Chaining cost computed " << revisions + 1 << " times" << "\n";
+    return costs[n-1];
+  }
+
+  int compute_semiglobal(const std::vector<std::tuple<int, int, int>> &anchors, bool incremental = false, RevisionStats *stats = NULL)
+  {
+    AnchorSet s;
+    s.assign(anchors);
+    return compute_semiglobal(s, incremental, stats);
+  }
+
+  /**
+   * @brief   one of several anchor sets chained for the same query, e.g., one per
+   *          strand and target record
+   **/
+  struct ChainCandidate
+  {
+    int strand = 0;                 //0 forward, 1 reverse complement of query
+    int record = 0;                 //index of target record
+    std::vector<std::tuple<int, int, int>> matches;
+    AnchorSet anchors;
+    RevisionStats stats;
+    int cost = 0;
+    bool exact = false;             //cost is optimal, otherwise it is a lower bound
+  };
+
+  /**
+   * @brief   chain anchor sets of several candidates in lockstep, all of them run the passes
+   *          of the bound-doubling loop with the same bound
+   *          a cost within the bound is optimal, a cost beyond it can only be larger; so once
+   *          one candidate is optimal the others are abandoned, unless within >= 0, in which
+   *          case passes continue until every candidate of cost <= within is optimal
+   *          abandoned candidates get cost bound + 1, a lower bound
+   **/
+  void compute_lockstep(ChainCandidate *c, std::size_t count, bool semiglobal, bool incremental, int within = -1)
+  {
+    int bound_redit = 100; //distance assumed to be <= 100
+    int revisions = 0;
+
+    for (std::size_t k = 0; k < count; k++)
+    {
+      c[k].stats.clear();
+      c[k].exact = false;
+    }
 
-      for(int j=1; j<n; j++)
+    while (true)
+    {
+      bool any = false, all = true;
+      for (std::size_t k = 0; k < count; k++)
       {
-        //compute cost[i] here
-        int find_min_cost = std::numeric_limits<int>::max();
+        if (!c[k].exact)
+        {
+          AnchorSet &s = c[k].anchors;
+          chaining_pass(s, bound_redit / 4, bound_redit, semiglobal, incremental && revisions > 0, &c[k].stats);
+          c[k].cost = s.cost[s.n - 1];
+          c[k].exact = c[k].cost <= bound_redit;
+        }
+        any = any || c[k].exact;
+        all = all && c[k].exact;
+      }
+
+      if (all || (within < 0 ? any : bound_redit >= within))
+        break;
+
+      bound_redit = bound_redit * 4;
+      revisions++;
+    }
+
+    for (std::size_t k = 0; k < count; k++)
+      if (!c[k].exact) c[k].cost = bound_redit + 1;
+  }
 
-        int j_a = std::get<0>(anchors[j]);
-        int j_b = std::get<0>(anchors[j]) + std::get<2>(anchors[j]) - 1;
-        int j_c = std::get<1>(anchors[j]);
-        int j_d = std::get<1>(anchors[j]) + std::get<2>(anchors[j]) - 1;
+  /**
+   * @brief   cost of connecting anchor i to anchor j (gap cost + overlap cost),
+   *          returns int max if i does not precede j under strong precedence criteria
+   **/
+  inline int connect_cost(const std::tuple<int, int, int> &anchor_i, const std::tuple<int, int, int> &anchor_j)
+  {
+    int i_a = std::get<0>(anchor_i);
+    int i_b = std::get<0>(anchor_i) + std::get<2>(anchor_i) - 1;
+    int i_c = std::get<1>(anchor_i);
+    int i_d = std::get<1>(anchor_i) + std::get<2>(anchor_i) - 1;
+
+    int j_a = std::get<0>(anchor_j);
+    int j_b = std::get<0>(anchor_j) + std::get<2>(anchor_j) - 1;
+    int j_c = std::get<1>(anchor_j);
+    int j_d = std::get<1>(anchor_j) + std::get<2>(anchor_j) - 1;
 
-        // anchor i < anchor j 
+    if (!(i_a < j_a && i_b < j_b && i_c < j_c && i_d < j_d))
+      return std::numeric_limits<int>::max();
 
-        while (j_a - std::get<0>(anchors[inner_loop_start]) - 1 > bound_redit)
-          inner_loop_start++;
+    int gap1 = std::max(0, j_a - i_b - 1);
+    int gap2 = std::max(0, j_c - i_d - 1);
+    int g = std::max(gap1,gap2);
 
+    int overlap1 = std::max(0, i_b - j_a + 1);
+    int overlap2 = std::max(0, i_d - j_c + 1);
+    int o = std::abs(overlap1 - overlap2);
+
+    return g + o;
+  }
+
+  /**
+   * @brief   exact chaining engine with O(n log^2 n) running time irrespective of divergence
+   *          anchors are processed in sorted order with divide-and-conquer; predecessors from the
+   *          left half are split by diagonal (ref - qry) order and by gap vs. overlap case, and each
+   *          case is answered using a range-minimum query over the diagonal rank
+   *
+   *          let A = j_a - i_a, C = j_c - i_c, len = length of anchor i, then
+   *          cost(i,j) = max(A,C) - min(A,C,len) whenever i precedes j, and the same value is the
+   *          cost of a valid alignment path for any i with i_a <= j_a and i_c <= j_c, which allows
+   *          the case conditions below to be relaxed without changing the optimal cost
+   *            diag_i <= diag_j, gap:      i_d <  j_c                    cost = j_a - i_b - 1
+   *            diag_i <= diag_j, overlap:  i_c <= j_c <= i_d + 1          cost = diag_j - diag_i
+   *            diag_i >  diag_j, gap:      i_b <  j_a                    cost = j_c - i_d - 1
+   *            diag_i >  diag_j, overlap:  i_a <= j_a <= i_b + 1          cost = diag_i - diag_j
+   *
+   *          each case bounds a predecessor in a second coordinate besides the diagonal, from
+   *          both sides in the overlap cases, and a predecessor's cost is final only once the
+   *          anchors before it are done. Divide-and-conquer answers the cases offline with one
+   *          plain segment tree per level; this costs a second log factor over an O(n log n)
+   *          single sweep, which would need a tree per diagonal with insertions and deletions
+   **/
+  class ChainRMQ
+  {
+    private:
+      const std::vector<std::tuple<int, int, int>> &anchors;
+      std::vector<int> &costs;
+      aligned_ivec *preds;             //argmin predecessor of each anchor, if wanted
+
+      RangeMinTree tree;
+      std::vector<int> left;           //left half anchors, ordered by diagonal
+      std::vector<int> left_diag;      //sorted diagonals of left half
+      std::vector<int> rank;           //rank of left half anchor in diagonal order
+      std::vector<int> order_left;     //scratch
+      std::vector<int> order_left2;    //scratch
+      std::vector<int> order_right;    //scratch
+      std::vector<int> diag_rank;      //count of left half diagonals <= diagonal of right half anchor
+
+      static const int brute_force_size = 32;
+
+      int a(int k) const { return std::get<0>(anchors[k]); }
+      int b(int k) const { return std::get<0>(anchors[k]) + std::get<2>(anchors[k]) - 1; }
+      int c(int k) const { return std::get<1>(anchors[k]); }
+      int d(int k) const { return std::get<1>(anchors[k]) + std::get<2>(anchors[k]) - 1; }
+      int diag(int k) const { return std::get<0>(anchors[k]) - std::get<1>(anchors[k]); }
+
+      void relax(int j, int value, int i)
+      {
+        if (value != std::numeric_limits<int>::max() && value < costs[j])
         {
-          //always consider the first dummy anchor 
-          //connection to first dummy anchor is done with modified cost to allow free gaps
-          int i_d = std::get<1>(anchors[0]) + std::get<2>(anchors[0]) - 1;
-          int qry_gap = j_c - i_d - 1;
-          find_min_cost = std::min(find_min_cost, costs[0] + qry_gap);
+          costs[j] = value;
+          if (preds) (*preds)[j] = i;
         }
+      }
 
-        //process all anchors in array for the final last dummy anchor
-        if (j == n-1) inner_loop_start=0;
+      //shifts a range-minimum result, keeping int max as 'not found'
+      static int shift(int value, int delta)
+      {
+        return value == std::numeric_limits<int>::max() ? value : value + delta;
+      }
 
-        for(int i=j-1; i>=inner_loop_start; i--)
+      //contribution of anchors [lo, mid) to anchors [mid, hi)
+      void cross(int lo, int mid, int hi)
+      {
+        left.clear();
+        for(int i = lo; i < mid; i++)
+          if (costs[i] < std::numeric_limits<int>::max())
+            left.push_back(i);
+        if (left.empty()) return;
+
+        int m = left.size();
+        std::sort(left.begin(), left.end(), [&](int x, int y) { return diag(x) < diag(y); });
+        left_diag.resize(m);
+        rank.resize(mid - lo);
+        for(int r = 0; r < m; r++)
         {
-          int i_a = std::get<0>(anchors[i]);
-          int i_b = std::get<0>(anchors[i]) + std::get<2>(anchors[i]) - 1;
-          int i_c = std::get<1>(anchors[i]);
-          int i_d = std::get<1>(anchors[i]) + std::get<2>(anchors[i]) - 1;
+          left_diag[r] = diag(left[r]);
+          rank[left[r] - lo] = r;
+        }
 
-          if (costs[i] < std::numeric_limits<int>::max() && i_a < j_a && i_b < j_b && i_c < j_c && i_d < j_d)
-          {
-            int gap1 = std::max(0, j_a - i_b - 1);
-            int gap2 = std::max(0, j_c - i_d - 1);
+        diag_rank.resize(hi - mid);
+        for(int j = mid; j < hi; j++)
+          diag_rank[j - mid] = std::upper_bound(left_diag.begin(), left_diag.end(), diag(j)) - left_diag.begin();
 
-            if (j == n-1) gap1=0; //modified cost for the last dummy anchor to allow free gaps
-            int g = std::max(gap1,gap2);
+        order_right.resize(hi - mid);
+        for(int j = mid; j < hi; j++) order_right[j - mid] = j;
+        std::sort(order_right.begin(), order_right.end(), [&](int x, int y) { return c(x) < c(y); });
 
-            int overlap1 = std::max(0, i_b - j_a + 1);
-            int overlap2 = std::max(0, i_d - j_c + 1);
-            int o = std::abs(overlap1 - overlap2);
+        //case: diag_i <= diag_j, gap
+        order_left = left;
+        std::sort(order_left.begin(), order_left.end(), [&](int x, int y) { return d(x) < d(y); });
+        tree.reset(m);
+        for(int p = 0, q = 0; q < hi - mid; q++)
+        {
+          int j = order_right[q];
+          for(; p < m && d(order_left[p]) < c(j); p++)
+            tree.set(rank[order_left[p] - lo], costs[order_left[p]] - b(order_left[p]), order_left[p]);
+          int i, value = tree.query(0, diag_rank[j - mid], &i);
+          relax(j, shift(value, a(j) - 1), i);
+        }
 
-            find_min_cost = std::min(find_min_cost, costs[i] + g + o);
-          }
+        //case: diag_i <= diag_j, overlap
+        order_left2 = order_left; //sorted by query end
+        std::sort(order_left.begin(), order_left.end(), [&](int x, int y) { return c(x) < c(y); });
+        tree.reset(m);
+        for(int p = 0, r = 0, q = 0; q < hi - mid; q++)
+        {
+          int j = order_right[q];
+          for(; p < m && c(order_left[p]) <= c(j); p++)
+            tree.set(rank[order_left[p] - lo], costs[order_left[p]] - diag(order_left[p]), order_left[p]);
+          for(; r < m && d(order_left2[r]) + 1 < c(j); r++)
+            tree.set(rank[order_left2[r] - lo], std::numeric_limits<int>::max());
+          int i, value = tree.query(0, diag_rank[j - mid], &i);
+          relax(j, shift(value, diag(j)), i);
         }
 
-        //save optimal cost at offset j
-        costs[j] = find_min_cost;
+        //case: diag_i > diag_j, gap
+        //right half is already sorted by reference start
+        order_left = left;
+        std::sort(order_left.begin(), order_left.end(), [&](int x, int y) { return b(x) < b(y); });
+        tree.reset(m);
+        for(int p = 0, j = mid; j < hi; j++)
+        {
+          for(; p < m && b(order_left[p]) < a(j); p++)
+            tree.set(rank[order_left[p] - lo], costs[order_left[p]] - d(order_left[p]), order_left[p]);
+          int i, value = tree.query(diag_rank[j - mid], m, &i);
+          relax(j, shift(value, c(j) - 1), i);
+        }
+
+        //case: diag_i > diag_j, overlap
+        tree.reset(m);
+        for(int p = m-1, j = hi-1; j >= mid; j--)
+        {
+          for(; p >= 0 && b(order_left[p]) + 1 >= a(j); p--)
+            tree.set(rank[order_left[p] - lo], costs[order_left[p]] + diag(order_left[p]), order_left[p]);
+          int i, value = tree.query(diag_rank[j - mid], m, &i);
+          relax(j, shift(value, -diag(j)), i);
+        }
       }
 
-      if (costs[n-1] > bound_redit)
+    public:
+      ChainRMQ(const std::vector<std::tuple<int, int, int>> &anchors_, std::vector<int> &costs_, aligned_ivec *preds_ = NULL)
+        : anchors(anchors_), costs(costs_), preds(preds_) {}
+
+      /**
+       * @brief   finalize costs of anchors [lo, hi), assuming anchors are sorted by reference start
+       *          and all contributions from anchors before lo are already accounted for
+       **/
+      void solve(int lo, int hi)
       {
-        bound_redit = bound_redit * 4;
-        revisions++;
+        if (hi - lo <= brute_force_size)
+        {
+          for(int j = lo + 1; j < hi; j++)
+            for(int i = lo; i < j; i++)
+              if (costs[i] < std::numeric_limits<int>::max())
+                relax(j, shift(connect_cost(anchors[i], anchors[j]), costs[i]), i);
+          return;
+        }
+
+        int mid = lo + (hi - lo) / 2;
+        solve(lo, mid);
+        cross(lo, mid, hi);
+        solve(mid, hi);
       }
-      else
-        break;
+  };
+
+  /**
+   * @brief   compute anchor-restricted edit distance using strong precedence criteria
+   * 			    range-minimum query based chaining, comparison mode: global
+   * @param   trace   if given, receives the anchors with their costs and the argmin predecessor
+   *                  of each anchor, for trace_chain()
+   **/
+  int compute_global_rmq(const std::vector<std::tuple<int, int, int>> &anchors, AnchorSet *trace = NULL)
+  {
+    int n = anchors.size();
+    std::vector<int> costs(n, std::numeric_limits<int>::max());
+    costs[0] = 0;
+
+    aligned_ivec *preds = NULL;
+    if (trace)
+    {
+      trace->assign(anchors);
+      trace->pred.assign(n, -1);
+      preds = &trace->pred;
     }
 
+    ChainRMQ(anchors, costs, preds).solve(0, n);
+
     if (VERBOSE)
       std::cerr << "Cost array = " << costs << "\n";
 
-    if (VERBOSE)
-      std::cerr << "Chaining cost computed " << revisions + 1 << " times" << "\n";
+    if (trace) trace->cost.assign(costs.begin(), costs.end());
     return costs[n-1];
   }
 
   /**
-   * @brief   compute anchor-restricted edit distance using standard edit-distance like dynamic programming 
+   * @brief   compute anchor-restricted (semi-global) edit distance using strong precedence criteria
+   * 			    range-minimum query based chaining
+   * @param   trace   as in compute_global_rmq()
    **/
-  int DP_global(const std::vector<std::tuple<int, int, int>> &anchors)
+  int compute_semiglobal_rmq(const std::vector<std::tuple<int, int, int>> &anchors, AnchorSet *trace = NULL)
   {
     int n = anchors.size();
+    std::vector<int> costs(n, 0);
 
-    //get sequence lengths from end dummy anchor
-    //assuming anchors are already sorted
-    int len_ref = std::get<0>(anchors[n-1]);
-    int len_qry = std::get<1>(anchors[n-1]);
-
-    //initialize a boolean matrix (len_ref+1 x len_qry+1)
-    //we will offset by 1 to be consistent with DP matrix
-    std::vector<std::vector<bool> > matchAllowed(len_ref+1);
-    for(int i=0; i<len_ref+1; i++) matchAllowed[i] = std::vector<bool>(len_qry+1, false);
-    for(int i = 0; i<n-1; i++) //use all (except end dummy) anchors
+    aligned_ivec *preds = NULL;
+    if (trace)
     {
-      int e_a = std::get<0>(anchors[i]);
-      int e_c = std::get<1>(anchors[i]);
-      int e_len = std::get<2>(anchors[i]);
+      trace->assign(anchors);
+      trace->pred.assign(n, 0);
+      trace->pred[0] = -1;
+      preds = &trace->pred;
+    }
+
+    //connection to first dummy anchor is done with modified cost to allow free gaps
+    for(int j=1; j<n-1; j++) costs[j] = std::get<1>(anchors[j]);
 
-      for(int j=0; j<e_len; j++)
+    //last dummy anchor is excluded, it is connected separately with free gaps
+    ChainRMQ(anchors, costs, preds).solve(0, n-1);
+
+    int len_qry = std::get<1>(anchors[n-1]);
+    costs[n-1] = std::numeric_limits<int>::max();
+    for(int i=0; i<n-1; i++)
+    {
+      int i_d = std::get<1>(anchors[i]) + std::get<2>(anchors[i]) - 1;
+      int value = costs[i] + std::max(0, len_qry - i_d - 1);
+      if (value < costs[n-1])
       {
-        matchAllowed[e_a+1  + j][e_c+1  + j] = true;
+        costs[n-1] = value;
+        if (preds) (*preds)[n-1] = i;
       }
     }
 
+    if (VERBOSE)
+      std::cerr << "Cost array = " << costs << "\n";
+
+    if (trace) trace->cost.assign(costs.begin(), costs.end());
+    return costs[n-1];
+  }
 
-    //initialize dp_matrix (len_ref+1 x len_qry+1) 
-    std::vector<std::vector<int> > dp_matrix(len_ref+1);
-    for(int i=0; i<=len_ref; i++) dp_matrix[i] = std::vector<int>(len_qry+1);
-    for(int i=0; i<=len_ref; i++) dp_matrix[i][0] = i;
-    for(int j=0; j<=len_qry; j++) dp_matrix[0][j] = j;
+  /**
+   * @brief   recover an optimal chain, walking back from the last dummy anchor along s.pred
+   *          if the chaining engine recorded it (range-minimum query engine), otherwise from
+   *          the final costs: s.pred[j] then receives the predecessor of every chained anchor j,
+   *          found by a backward scan, so the cost-only path of the other engines is unaffected.
+   *          Chains of the range-minimum query engine may link anchors sharing a start coordinate
+   *          (relaxed precedence), their cost is that of the path trimming the later anchor
+   * @param   chain   indices of chained anchors in increasing order, dummy anchors excluded
+   **/
+  void trace_chain(AnchorSet &s, bool semiglobal, std::vector<int> &chain)
+  {
+    int n = s.n;
+    chain.clear();
 
-    for(int i=1; i<=len_ref; i++)
+    if ((int) s.pred.size() == n)
     {
-      for(int j=1; j<=len_qry; j++)
-      {
-        if (matchAllowed[i][j])
-          dp_matrix[i][j] = std::min({dp_matrix[i - 1][j - 1], dp_matrix[i - 1][j] + 1, dp_matrix[i][j - 1] + 1});
-        else
-          dp_matrix[i][j] = std::min({dp_matrix[i - 1][j - 1] + 1, dp_matrix[i - 1][j] + 1, dp_matrix[i][j - 1] + 1});
-      }
+      for(int j = s.pred[n-1]; j > 0; j = s.pred[j])
+        chain.push_back(j);
+
+      std::reverse(chain.begin(), chain.end());
+      return;
+    }
+
+    s.pred.assign(n, -1);
+    for(int j = n-1; j > 0; j = s.pred[j])
+    {
+      //first dummy anchor, connected with free reference gap in semi-global mode
+      int from_start = semiglobal ? s.cost[0] + s.c[j] - s.d[0] - 1 : predecessor_cost(s, 0, j, false);
+
+      if (from_start == s.cost[j])
+        s.pred[j] = 0;
+      else
+        for(int i = j-1; i > 0; i--)
+          if (predecessor_cost(s, i, j, semiglobal && j == n-1) == s.cost[j])
+          {
+            s.pred[j] = i;
+            break;
+          }
+
+      assert(s.pred[j] != -1);
+      if (s.pred[j] <= 0) break;
+      chain.push_back(s.pred[j]);
     }
 
-    return dp_matrix[len_ref][len_qry];
+    std::reverse(chain.begin(), chain.end());
   }
 
   /**
-   * @brief   compute anchor-restricted (semi-global) edit distance using standard edit-distance like dynamic programming 
+   * @brief   anchor-restricted edit distance by edit-distance like dynamic programming,
+   *          keeping two rolling rows of the (len_ref+1 x len_qry+1) matrix
+   *          cells where a match is allowed are rebuilt per row from the anchors spanning it,
+   *          as a bit vector over the row, memory is O(len_qry + n)
+   *          if semiglobal is set, gaps at either end of the reference are free
    **/
-  int DP_semiglobal(const std::vector<std::tuple<int, int, int>> &anchors)
+  int DP_rolling(const std::vector<std::tuple<int, int, int>> &anchors, bool semiglobal)
   {
     int n = anchors.size();
 
@@ -236,43 +638,69 @@ namespace chainx
     int len_ref = std::get<0>(anchors[n-1]);
     int len_qry = std::get<1>(anchors[n-1]);
 
-    //initialize a boolean matrix (len_ref+1 x len_qry+1)
-    //we will offset by 1 to be consistent with DP matrix
-    std::vector<std::vector<bool> > matchAllowed(len_ref+1);
-    for(int i=0; i<len_ref+1; i++) matchAllowed[i] = std::vector<bool>(len_qry+1, false);
-    for(int i = 0; i<n-1; i++) //use all (except end dummy) anchors
-    {
-      int e_a = std::get<0>(anchors[i]);
-      int e_c = std::get<1>(anchors[i]);
-      int e_len = std::get<2>(anchors[i]);
+    std::vector<int> prev(len_qry+1), cur(len_qry+1);
+    std::vector<uint64_t> matchAllowed(len_qry / 64 + 1, 0);    //bits of current row
+    std::vector<int> active;                                      //anchors spanning current row
+
+    for(int j=0; j<=len_qry; j++) prev[j] = j;
+    int final_distance = prev[len_qry];
+    int next = 0;
 
-      for(int j=0; j<e_len; j++)
+    for(int i=1; i<=len_ref; i++)
+    {
+      //anchors starting at this row, all (except end dummy) anchors are used
+      while (next < n-1 && std::get<0>(anchors[next]) + 1 <= i)
       {
-        matchAllowed[e_a+1  + j][e_c+1  + j] = true;
+        if (std::get<0>(anchors[next]) + std::get<2>(anchors[next]) >= i)
+          active.push_back(next);
+        next++;
       }
-    }
-
 
-    //initialize dp_matrix (len_ref+1 x len_qry+1) 
-    std::vector<std::vector<int> > dp_matrix(len_ref+1);
-    for(int i=0; i<=len_ref; i++) dp_matrix[i] = std::vector<int>(len_qry+1);
-    for(int i=0; i<=len_ref; i++) dp_matrix[i][0] = 0; //changed from i to 0 for free gaps
-    for(int j=0; j<=len_qry; j++) dp_matrix[0][j] = j;
+      //mark allowed cells
+      for (int k : active)
+      {
+        int col = std::get<1>(anchors[k])+1 + (i - std::get<0>(anchors[k])-1);
+        matchAllowed[col >> 6] |= 1ULL << (col & 63);
+      }
 
-    for(int i=1; i<=len_ref; i++)
-    {
+      cur[0] = semiglobal ? 0 : i; //free gaps on reference in semi-global mode
       for(int j=1; j<=len_qry; j++)
       {
-        if (matchAllowed[i][j])
-          dp_matrix[i][j] = std::min({dp_matrix[i - 1][j - 1], dp_matrix[i - 1][j] + 1, dp_matrix[i][j - 1] + 1});
-        else
-          dp_matrix[i][j] = std::min({dp_matrix[i - 1][j - 1] + 1, dp_matrix[i - 1][j] + 1, dp_matrix[i][j - 1] + 1});
+        int mismatch = (matchAllowed[j >> 6] >> (j & 63) & 1) ? 0 : 1;
+        cur[j] = std::min({prev[j - 1] + mismatch, prev[j] + 1, cur[j - 1] + 1});
       }
+
+      //clear bits of this row, and drop anchors ending at this row
+      std::size_t kept = 0;
+      for (int k : active)
+      {
+        int col = std::get<1>(anchors[k])+1 + (i - std::get<0>(anchors[k])-1);
+        matchAllowed[col >> 6] = 0;
+        if (i < std::get<0>(anchors[k]) + std::get<2>(anchors[k])) active[kept++] = k;
+      }
+      active.resize(kept);
+
+      final_distance = std::min(final_distance, cur[len_qry]);
+      prev.swap(cur);
     }
 
-    int final_distance = std::numeric_limits<int>::max();
-    for(int i=0; i<=len_ref; i++) final_distance = std::min (final_distance, dp_matrix[i][len_qry]);
-    return final_distance;
+    return semiglobal ? final_distance : prev[len_qry];
+  }
+
+  /**
+   * @brief   compute anchor-restricted edit distance using standard edit-distance like dynamic programming 
+   **/
+  int DP_global(const std::vector<std::tuple<int, int, int>> &anchors)
+  {
+    return DP_rolling(anchors, false);
+  }
+
+  /**
+   * @brief   compute anchor-restricted (semi-global) edit distance using standard edit-distance like dynamic programming 
+   **/
+  int DP_semiglobal(const std::vector<std::tuple<int, int, int>> &anchors)
+  {
+    return DP_rolling(anchors, true);
   }
 }
 
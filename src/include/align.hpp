@@ -0,0 +1,249 @@
+#ifndef CHAINX_ALIGN_H
+#define CHAINX_ALIGN_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <utility>
+#include <algorithm>
+
+//third-party lib
+#include "edlib/edlib.h"
+
+//own includes
+#include "anchors.hpp"
+#include "parallel.hpp"
+
+namespace chainx
+{
+  /**
+   * @brief   base-level alignment of a query along an anchor chain
+   *          coordinates are 0-based, end exclusive
+   **/
+  struct ChainAlignment
+  {
+    int t_start = 0, t_end = 0;       //aligned target interval
+    int edit_distance = 0;            //exact edit distance of the alignment
+    int matches = 0;                  //count of '=' columns
+    int columns = 0;                  //alignment length
+    std::string cigar;                //extended CIGAR (=, X, I, D), I consumes query only
+  };
+
+  /**
+   * @brief   run-length encoded alignment operations, appended with merging of equal ops
+   **/
+  typedef std::vector<std::pair<char, int>> CigarOps;
+
+  inline void append_op(CigarOps &ops, char op, int count)
+  {
+    if (count <= 0) return;
+    if (!ops.empty() && ops.back().first == op)
+      ops.back().second += count;
+    else
+      ops.emplace_back(op, count);
+  }
+
+  /**
+   * @brief   region between two consecutive chained anchors, aligned independently
+   *          free_start: target start is free (semi-global, before first anchor)
+   *          free_end: target end is free (semi-global, after last anchor)
+   **/
+  struct AlignmentGap
+  {
+    int r0, r1, q0, q1;
+    bool free_start = false, free_end = false;
+
+    CigarOps ops;                     //filled by align_gap
+    int edit_distance = 0;
+    int t_start = 0, t_end = 0;       //target interval actually used
+  };
+
+  /**
+   * @brief   align query[q0, q1) to target[r0, r1) with edlib, globally unless one
+   *          target end is free, in which case that end is clipped to the best position
+   **/
+  inline void align_gap(const std::string &qry, const std::string &ref, AlignmentGap &g)
+  {
+    static const char edop_to_cigar[] = {'=', 'I', 'D', 'X'};
+    int qlen = g.q1 - g.q0, rlen = g.r1 - g.r0;
+    g.t_start = g.r0;
+    g.t_end = g.r1;
+    g.ops.clear();
+
+    //trivial gaps are indels only, no need to call edlib
+    if (qlen == 0 || rlen == 0)
+    {
+      if (g.free_start || g.free_end)
+      {
+        //query residues are inserted, target is clipped
+        append_op(g.ops, 'I', qlen);
+        g.edit_distance = qlen;
+        if (g.free_start) g.t_start = g.r1; else g.t_end = g.r0;
+      }
+      else
+      {
+        append_op(g.ops, 'I', qlen);
+        append_op(g.ops, 'D', rlen);
+        g.edit_distance = qlen + rlen;
+      }
+      return;
+    }
+
+    if (!g.free_start && !g.free_end)
+    {
+      EdlibAlignResult result = edlibAlign(qry.data() + g.q0, qlen, ref.data() + g.r0, rlen,
+          edlibNewAlignConfig(-1, EDLIB_MODE_NW, EDLIB_TASK_PATH, NULL, 0));
+      g.edit_distance = result.editDistance;
+      for (int k = 0; k < result.alignmentLength; k++) append_op(g.ops, edop_to_cigar[result.alignment[k]], 1);
+      edlibFreeAlignResult(result);
+    }
+    else if (g.free_end)
+    {
+      //prefix alignment, gap after query end is not penalized
+      EdlibAlignResult result = edlibAlign(qry.data() + g.q0, qlen, ref.data() + g.r0, rlen,
+          edlibNewAlignConfig(-1, EDLIB_MODE_SHW, EDLIB_TASK_PATH, NULL, 0));
+      g.edit_distance = result.editDistance;
+      g.t_end = g.r0 + result.endLocations[0] + 1;
+      for (int k = 0; k < result.alignmentLength; k++) append_op(g.ops, edop_to_cigar[result.alignment[k]], 1);
+      edlibFreeAlignResult(result);
+    }
+    else
+    {
+      //suffix alignment, solved as a prefix alignment of the reversed sequences
+      std::string q_rev (qry.rbegin() + (qry.length() - g.q1), qry.rbegin() + (qry.length() - g.q0));
+      std::string r_rev (ref.rbegin() + (ref.length() - g.r1), ref.rbegin() + (ref.length() - g.r0));
+      EdlibAlignResult result = edlibAlign(q_rev.data(), qlen, r_rev.data(), rlen,
+          edlibNewAlignConfig(-1, EDLIB_MODE_SHW, EDLIB_TASK_PATH, NULL, 0));
+      g.edit_distance = result.editDistance;
+      g.t_start = g.r1 - (result.endLocations[0] + 1);
+      for (int k = result.alignmentLength - 1; k >= 0; k--) append_op(g.ops, edop_to_cigar[result.alignment[k]], 1);
+      edlibFreeAlignResult(result);
+    }
+  }
+
+  /**
+   * @brief   align query to target along chain, anchors are taken as exact matches and
+   *          only the gaps between consecutive anchors are aligned with edlib, using
+   *          'threads' workers. Overlaps between consecutive anchors are resolved by
+   *          trimming the start of the later anchor.
+   *          In semi-global mode, target ends outside the chain are free; the query is
+   *          searched in at most twice its unaligned length of target beyond the chain ends
+   * @param   transposed  anchors in s are keyed on query, i.e., <qry, ref, len>
+   **/
+  inline void align_chain(const std::string &qry, const std::string &ref, const AnchorSet &s, const std::vector<int> &chain,
+      bool transposed, bool semiglobal, int threads, ChainAlignment &aln)
+  {
+    const aligned_ivec &ref_start = transposed ? s.c : s.a;
+    const aligned_ivec &qry_start = transposed ? s.a : s.c;
+    int len_ref = ref.length(), len_qry = qry.length();
+
+    //lengths of anchors used in the alignment after trimming overlaps
+    std::vector<int> used;
+    std::vector<AlignmentGap> gaps;
+    int r = 0, q = 0;
+    for (int k : chain)
+    {
+      int len = s.b[k] - s.a[k] + 1;
+      int skip = std::max(0, std::max(r - ref_start[k], q - qry_start[k]));
+      if (skip >= len) continue;
+
+      AlignmentGap g;
+      g.r0 = r; g.r1 = ref_start[k] + skip;
+      g.q0 = q; g.q1 = qry_start[k] + skip;
+      if (semiglobal && used.empty())
+      {
+        g.free_start = true;
+        g.r0 = std::max(0, g.r1 - 2 * (g.q1 - g.q0));
+      }
+      gaps.push_back(g);
+      used.push_back(len - skip);
+
+      r = ref_start[k] + len;
+      q = qry_start[k] + len;
+    }
+
+    AlignmentGap last;
+    last.r0 = r; last.r1 = len_ref;
+    last.q0 = q; last.q1 = len_qry;
+    if (semiglobal)
+    {
+      if (used.empty())
+      {
+        //no anchor to start from, fall back to infix alignment of the whole query
+        EdlibAlignResult result = edlibAlign(qry.data(), len_qry, ref.data(), len_ref,
+            edlibNewAlignConfig(-1, EDLIB_MODE_HW, EDLIB_TASK_PATH, NULL, 0));
+        last.r0 = result.startLocations[0];
+        last.r1 = result.endLocations[0] + 1;
+        edlibFreeAlignResult(result);
+      }
+      else
+      {
+        last.free_end = true;
+        last.r1 = std::min(len_ref, last.r0 + 2 * (last.q1 - last.q0));
+      }
+    }
+    gaps.push_back(last);
+
+    parallel_for(gaps.size(), threads, [&](int, std::size_t k)
+    {
+      align_gap(qry, ref, gaps[k]);
+    });
+
+    //stitch gaps and anchors
+    CigarOps ops;
+    aln.edit_distance = 0;
+    for (std::size_t k = 0; k < gaps.size(); k++)
+    {
+      for (auto &op : gaps[k].ops) append_op(ops, op.first, op.second);
+      aln.edit_distance += gaps[k].edit_distance;
+      if (k < used.size()) append_op(ops, '=', used[k]);
+    }
+
+    aln.t_start = gaps.front().t_start;
+    aln.t_end = gaps.back().t_end;
+    aln.matches = aln.columns = 0;
+    aln.cigar.clear();
+    for (auto &op : ops)
+    {
+      aln.columns += op.second;
+      if (op.first == '=') aln.matches += op.second;
+      aln.cigar += std::to_string(op.second);
+      aln.cigar += op.first;
+    }
+  }
+
+  /**
+   * @brief   initial edlib band for a query whose chaining cost is known but not its
+   *          chain, the cost is scaled by 9/8 plus a constant slack in case it underestimates
+   **/
+  inline int band_from_cost(int chain_cost)
+  {
+    return chain_cost + chain_cost / 8 + 32;
+  }
+
+  /**
+   * @brief   exact edit distance of query to target, computed by edlib within band k
+   *          band is doubled and edlib rerun while no alignment within k exists;
+   *          once k reaches the longer sequence length, success is guaranteed
+   * @param   tries   count of edlib calls made
+   **/
+  inline int banded_edit_distance(const std::string &qry, const std::string &ref, bool semiglobal, int k, int &tries)
+  {
+    int max_len = std::max(qry.length(), ref.length());
+    EdlibAlignMode mode = semiglobal ? EDLIB_MODE_HW : EDLIB_MODE_NW;
+
+    for (tries = 1; ; tries++)
+    {
+      k = std::min(std::max(k, 1), max_len);
+      EdlibAlignResult result = edlibAlign(qry.data(), qry.length(), ref.data(), ref.length(),
+          edlibNewAlignConfig(k, mode, EDLIB_TASK_DISTANCE, NULL, 0));
+      int distance = result.status == EDLIB_STATUS_OK ? result.editDistance : -1;
+      edlibFreeAlignResult(result);
+
+      if (distance >= 0 || k == max_len) return distance;
+      k *= 2;
+    }
+  }
+}
+
+#endif
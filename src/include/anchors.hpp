@@ -0,0 +1,203 @@
+#ifndef CHAINX_ANCHORS_H
+#define CHAINX_ANCHORS_H
+
+#include <vector>
+#include <tuple>
+#include <limits>
+#include <cstdlib>
+#include <new>
+#include <cstdint>
+#include <utility>
+
+namespace chainx
+{
+  /**
+   * @brief   minimal allocator returning memory aligned to 'Alignment' bytes,
+   *          used to keep anchor arrays friendly to 256-bit vector loads
+   **/
+  template <typename T, std::size_t Alignment>
+  struct AlignedAllocator
+  {
+    typedef T value_type;
+
+    template <typename U> struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+    AlignedAllocator() {}
+    template <typename U> AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+    T* allocate(std::size_t n)
+    {
+      void *ptr = NULL;
+      if (posix_memalign(&ptr, Alignment, n * sizeof(T)) != 0)
+        throw std::bad_alloc();
+      return static_cast<T*>(ptr);
+    }
+
+    void deallocate(T *ptr, std::size_t) { free(ptr); }
+
+    template <typename U> bool operator==(const AlignedAllocator<U, Alignment> &) const { return true; }
+    template <typename U> bool operator!=(const AlignedAllocator<U, Alignment> &) const { return false; }
+  };
+
+  typedef std::vector<int, AlignedAllocator<int, 32> > aligned_ivec;
+
+  /**
+   * @brief   structure-of-arrays anchor storage
+   *          start/end coordinates on reference (a,b) and query (c,d) are precomputed
+   *          once, and kept next to the chaining cost array in contiguous aligned memory
+   **/
+  struct AnchorSet
+  {
+    int n = 0;
+    aligned_ivec a;       //reference start
+    aligned_ivec b;       //reference end (inclusive)
+    aligned_ivec c;       //query start
+    aligned_ivec d;       //query end (inclusive)
+    aligned_ivec cost;    //chaining cost of best chain ending at anchor
+    aligned_ivec pred;    //predecessor on optimal chain, filled by trace_chain() or the rmq engine, empty otherwise
+
+    /**
+     * @brief   fill arrays from <ref, qry, len> tuples, buffers are reused across calls
+     **/
+    void assign(const std::vector<std::tuple<int, int, int>> &anchors)
+    {
+      n = anchors.size();
+      a.resize(n); b.resize(n); c.resize(n); d.resize(n);
+      cost.assign(n, 0);
+      pred.clear();
+
+      for(int i = 0; i < n; i++)
+      {
+        a[i] = std::get<0>(anchors[i]);
+        b[i] = std::get<0>(anchors[i]) + std::get<2>(anchors[i]) - 1;
+        c[i] = std::get<1>(anchors[i]);
+        d[i] = std::get<1>(anchors[i]) + std::get<2>(anchors[i]) - 1;
+      }
+    }
+  };
+
+  /**
+   * @brief   LSD radix sort of <ref, qry, len> anchors by reference start, ties are
+   *          ordered by query start. Histograms of all digits are gathered in one pass and
+   *          digits shared by every anchor are skipped; scratch buffers are kept across calls
+   **/
+  class AnchorSorter
+  {
+    private:
+      static const int BITS = 11;                   //bits per digit
+      static const int BUCKETS = 1 << BITS;
+      static const int PASSES = 6;                  //3 digits of query start, then 3 of reference start
+
+      std::vector<std::tuple<int, int, int>> scratch;
+      std::vector<uint32_t> counts;
+
+      //coordinates are >= -1 (dummy anchor), shift by one to sort as unsigned
+      static uint32_t digit(const std::tuple<int, int, int> &t, int pass)
+      {
+        uint32_t key = pass < 3 ? (uint32_t)(std::get<1>(t) + 1) : (uint32_t)(std::get<0>(t) + 1);
+        return (key >> (BITS * (pass % 3))) & (BUCKETS - 1);
+      }
+
+      static bool less(const std::tuple<int, int, int> &a, const std::tuple<int, int, int> &b)
+      {
+        return std::get<0>(a) < std::get<0>(b) || (std::get<0>(a) == std::get<0>(b) && std::get<1>(a) < std::get<1>(b));
+      }
+
+    public:
+      void sort(std::vector<std::tuple<int, int, int>> &anchors)
+      {
+        const std::size_t n = anchors.size();
+
+        //insertion sort for short lists
+        if (n < 64)
+        {
+          for (std::size_t i = 1; i < n; i++)
+          {
+            std::tuple<int, int, int> t = anchors[i];
+            std::size_t k = i;
+            for (; k > 0 && less(t, anchors[k-1]); k--) anchors[k] = anchors[k-1];
+            anchors[k] = t;
+          }
+          return;
+        }
+
+        counts.assign(PASSES * BUCKETS, 0);
+        for (auto &t : anchors)
+          for (int p = 0; p < PASSES; p++)
+            counts[p * BUCKETS + digit(t, p)]++;
+
+        scratch.resize(n);
+        std::vector<std::tuple<int, int, int>> *src = &anchors, *dst = &scratch;
+
+        for (int p = 0; p < PASSES; p++)
+        {
+          uint32_t *c = counts.data() + p * BUCKETS;
+          if (c[digit((*src)[0], p)] == n) continue;   //all anchors share this digit
+
+          uint32_t sum = 0;
+          for (int b = 0; b < BUCKETS; b++)
+          {
+            uint32_t count = c[b];
+            c[b] = sum;
+            sum += count;
+          }
+
+          for (auto &t : *src)
+            (*dst)[c[digit(t, p)]++] = t;
+
+          std::swap(src, dst);
+        }
+
+        if (src != &anchors) anchors.swap(scratch);
+      }
+  };
+  /**
+   * @brief   gathers anchors reported by the suffix array walk between the two dummy anchors
+   *          keys anchors on reference start, or on query start if transposed (<qry, ref, len>)
+   *          and sorts only if they did not arrive in key order; MUMs arrive sorted by reference
+   *          and MEMs (sparseness 1) by query, so global chaining of either needs no sort
+   **/
+  class AnchorCollector
+  {
+    private:
+      std::vector<std::tuple<int, int, int>> &anchors;
+      bool transposed;
+      bool sorted = true;
+
+    public:
+      AnchorCollector(std::vector<std::tuple<int, int, int>> &anchors_, bool transposed_) : anchors(anchors_), transposed(transposed_) {}
+
+      bool is_transposed() const { return transposed; }
+
+      /**
+       * @brief   clear anchors and place the first dummy anchor
+       **/
+      void begin()
+      {
+        anchors.clear();
+        anchors.emplace_back(-1, -1, 1);
+        sorted = true;
+      }
+
+      void add(int ref, int qry, int len)
+      {
+        int key = transposed ? qry : ref;
+        if (key < std::get<0>(anchors.back())) sorted = false;
+        if (transposed)
+          anchors.emplace_back(qry, ref, len);
+        else
+          anchors.emplace_back(ref, qry, len);
+      }
+
+      /**
+       * @brief   place the last dummy anchor and sort if necessary
+       **/
+      void end(int len_ref, int len_qry, AnchorSorter &sorter)
+      {
+        add(len_ref, len_qry, 1);
+        if (!sorted) sorter.sort(anchors);
+      }
+  };
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef CHAINX_FILTER_H
+#define CHAINX_FILTER_H
+
+#include <vector>
+#include <tuple>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+
+//third-party lib
+#include "minimap2-2.24/sdust.h"
+
+namespace chainx
+{
+  const int SDUST_WINDOW = 64;      //window of the low-complexity filter, as in minimap2
+
+  /**
+   * @brief   removes anchors that would blow up chaining on repeats: anchors of query positions
+   *          with too many occurrences, and anchors inside low-complexity regions of the query
+   *          found by sdust (symmetric DUST); buffers are kept across calls
+   **/
+  class AnchorFilter
+  {
+    private:
+      std::vector<int> counts;                  //anchors per query start
+      std::vector<std::pair<int, int>> masked;  //low-complexity query intervals [start, end)
+      sdust_buf_t *buf;
+
+    public:
+      AnchorFilter() : buf(sdust_buf_init(0)) {}
+      AnchorFilter(const AnchorFilter &) = delete;
+      AnchorFilter& operator=(const AnchorFilter &) = delete;
+      ~AnchorFilter() { sdust_buf_destroy(buf); }
+
+      /**
+       * @brief   drop all <ref, qry, len> anchors of query positions that start more than
+       *          maxOcc anchors, similar to minimap2's mid_occ; returns count of anchors dropped
+       **/
+      std::size_t cap_occurrences(std::vector<std::tuple<int, int, int>> &anchors, int len_qry, int maxOcc)
+      {
+        if (maxOcc <= 0 || anchors.size() <= (std::size_t) maxOcc) return 0;
+
+        counts.assign(len_qry, 0);
+        for (auto &e : anchors) counts[std::get<1>(e)]++;
+
+        std::size_t n = anchors.size();
+        anchors.erase(std::remove_if(anchors.begin(), anchors.end(),
+              [&](const std::tuple<int, int, int> &e) { return counts[std::get<1>(e)] > maxOcc; }), anchors.end());
+        return n - anchors.size();
+      }
+
+      /**
+       * @brief   drop anchors lying entirely within a low-complexity interval of the query,
+       *          intervals score above 'threshold' in sdust; returns count of anchors dropped
+       **/
+      std::size_t mask_low_complexity(std::vector<std::tuple<int, int, int>> &anchors, const std::string &qseq, int threshold)
+      {
+        if (threshold <= 0 || anchors.empty()) return 0;
+
+        int n_intervals;
+        const uint64_t *intervals = sdust_core((const uint8_t*) qseq.data(), qseq.length(), threshold, SDUST_WINDOW, &n_intervals, buf);
+        if (n_intervals == 0) return 0;
+
+        //intervals are sorted and disjoint, masked[i] covers query positions up to its end
+        masked.resize(n_intervals);
+        for (int i = 0; i < n_intervals; i++) masked[i] = std::make_pair((int)(intervals[i] >> 32), (int)(uint32_t) intervals[i]);
+
+        std::size_t n = anchors.size();
+        anchors.erase(std::remove_if(anchors.begin(), anchors.end(), [&](const std::tuple<int, int, int> &e)
+        {
+          int st = std::get<1>(e), en = st + std::get<2>(e);
+          auto it = std::upper_bound(masked.begin(), masked.end(), std::make_pair(st, INT32_MAX));
+          return it != masked.begin() && (it - 1)->second >= en;
+        }), anchors.end());
+        return n - anchors.size();
+      }
+  };
+}
+
+#endif
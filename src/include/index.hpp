@@ -0,0 +1,251 @@
+#ifndef CHAINX_INDEX_H
+#define CHAINX_INDEX_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//third-party lib
+#include "mummer/sparseSA.hpp"
+
+//own includes
+#include "utils.hpp"
+
+namespace chainx
+{
+  const uint64_t INDEX_MAGIC = 0x5849584E49414843ULL;   //"CHAINXIX" on disk
+  const uint32_t INDEX_VERSION = 3;                     //bump whenever the on-disk layout changes
+  const uint64_t INDEX_ALIGNMENT = 4096;                //arrays start on page boundaries
+
+  /**
+   * @brief   location of one array inside the index file
+   **/
+  struct IndexSection
+  {
+    uint64_t offset = 0;            //bytes from start of file
+    uint64_t count = 0;             //number of elements
+  };
+
+  /**
+   * @brief   header at the start of <prefix>.chainx, ties an index to the exact
+   *          target sequence and build parameters (sparseness K among them, in aux),
+   *          and locates the arrays that follow; the packed target itself is one of them
+   **/
+  struct IndexHeader
+  {
+    uint64_t magic = 0;
+    uint32_t version = INDEX_VERSION;
+    int32_t minLen = 0;             //minimum anchor length the index was built for
+    uint64_t length = 0;            //target length in residues
+    uint64_t checksum = 0;          //checksum of packed target sequence
+    uint64_t fileSize = 0;          //total size of index file in bytes
+    mummer::mummer::sparseSA_aux aux;
+    int64_t kMerTableSize = 0;
+    IndexSection sa, isa, lcp, lcpLarge, kmer, child;
+    IndexSection words, flags, runs;  //packed target
+  };
+
+  /**
+   * @brief   read-only shared memory mapping of a whole file, unmapped on destruction
+   **/
+  class MappedFile
+  {
+    private:
+      void *base = MAP_FAILED;
+      std::size_t length = 0;
+
+    public:
+      MappedFile() {}
+      MappedFile(const MappedFile &) = delete;
+      MappedFile& operator=(const MappedFile &) = delete;
+      ~MappedFile() { if (base != MAP_FAILED) munmap(base, length); }
+
+      bool open(const std::string &path)
+      {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+          close(fd);
+          return false;
+        }
+
+        length = st.st_size;
+        base = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);    //mapping stays valid
+        return base != MAP_FAILED;
+      }
+
+      const char* data() const { return (const char*) base; }
+      std::size_t size() const { return length; }
+  };
+
+  /**
+   * @brief   append count elements at ptr to os, starting at the next aligned offset
+   **/
+  template <typename T>
+  inline IndexSection write_section(std::ofstream &os, const T *ptr, std::size_t count)
+  {
+    IndexSection section;
+    uint64_t pos = os.tellp();
+    uint64_t padding = (INDEX_ALIGNMENT - pos % INDEX_ALIGNMENT) % INDEX_ALIGNMENT;
+    std::vector<char> zeros (padding, 0);
+    os.write(zeros.data(), padding);
+
+    section.offset = pos + padding;
+    section.count = count;
+    os.write((const char*)ptr, count * sizeof(T));
+    return section;
+  }
+
+  /**
+   * @brief   write packed target, suffix array, LCP, ISA/child and k-mer table into a
+   *          single file <prefix>.chainx that can be memory-mapped and used in place
+   **/
+  inline bool save_index(const mummer::mummer::sparseSA &sa, const PackedSequence &target, int minLen, const std::string &prefix)
+  {
+    if (!sa.SA.is_small)
+    {
+      std::cerr << "ERROR, chainx::save_index, targets of 2^31 or more residues are not supported" << std::endl;
+      return false;
+    }
+
+    //padding bytes are zeroed and the build parameters copied field by field,
+    //so that the same target always gives the same index file
+    IndexHeader header;
+    std::memset((void*)&header, 0, sizeof(header));
+    header.version = INDEX_VERSION;
+    header.minLen = minLen;
+    header.length = target.size();
+    header.checksum = target.checksum();
+    header.aux.N = sa.N;
+    header.aux.K = sa.K;
+    header.aux.logN = sa.logN;
+    header.aux.NKm1 = sa.NKm1;
+    header.aux._4column = sa._4column;
+    header.aux.hasSufLink = sa.hasSufLink;
+    header.aux.hasChild = sa.hasChild;
+    header.aux.hasKmer = sa.hasKmer;
+    header.aux.kMerSize = sa.kMerSize;
+    header.aux.sparseMult = sa.sparseMult;
+    header.aux.nucleotidesOnly = sa.nucleotidesOnly;
+    header.kMerTableSize = sa.kMerTableSize;
+
+    std::ofstream os (prefix + ".chainx", std::ios::binary | std::ios::trunc);
+
+    //placeholder header without magic, a partially written index is never accepted
+    os.write((const char*)&header, sizeof(header));
+
+    header.sa = write_section(os, sa.SA.small.data(), sa.SA.size());
+    if (sa.hasSufLink) header.isa = write_section(os, sa.ISA.small.data(), sa.ISA.size());
+    header.lcp = write_section(os, sa.LCP.vec.data(), sa.LCP.vec.size());
+    header.lcpLarge = write_section(os, sa.LCP.M.data(), sa.LCP.M.size());
+    if (sa.hasKmer) header.kmer = write_section(os, sa.KMR.data(), sa.KMR.size());
+    if (sa.hasChild) header.child = write_section(os, sa.CHILD.data(), sa.CHILD.size());
+    header.words = write_section(os, target.words.data(), target.words.size());
+    header.flags = write_section(os, target.flags.data(), target.flags.size());
+    header.runs = write_section(os, target.runs.data(), target.runs.size());
+    header.fileSize = os.tellp();
+
+    header.magic = INDEX_MAGIC;
+    os.seekp(0);
+    os.write((const char*)&header, sizeof(header));
+    return os.good();
+  }
+
+  /**
+   * @brief   map index of target from <prefix>.chainx, arrays are used in place
+   *          from the page cache, 'file' must outlive the returned suffix array.
+   *          target is switched to the copy in the index, so that its pages are
+   *          shared too, and must outlive the suffix array as well.
+   *          Exits with an error if the index is missing, of another version, or
+   *          was built for a different target sequence, larger minimum anchor length
+   *          or another sparseness (unless sparseness is 0)
+   **/
+  inline mummer::mummer::sparseSA load_index(const std::string &prefix, PackedSequence &target, int minLen, int sparseness, MappedFile &file)
+  {
+    const IndexHeader *header = NULL;
+    if (file.open(prefix + ".chainx") && file.size() >= sizeof(IndexHeader))
+      header = (const IndexHeader*) file.data();
+
+    if (header == NULL || header->magic != INDEX_MAGIC)
+    {
+      std::cerr << "ERROR, chainx::load_index, " << prefix << ".chainx is missing or not a chainX index" << std::endl;
+      exit(1);
+    }
+
+    if (header->version != INDEX_VERSION)
+    {
+      std::cerr << "ERROR, chainx::load_index, index version " << header->version << " is not supported (expected " << INDEX_VERSION << "), rebuild the index" << std::endl;
+      exit(1);
+    }
+
+    if (header->fileSize != file.size())
+    {
+      std::cerr << "ERROR, chainx::load_index, " << prefix << ".chainx is truncated, rebuild the index" << std::endl;
+      exit(1);
+    }
+
+    if (header->length != target.size() || header->checksum != target.checksum())
+    {
+      std::cerr << "ERROR, chainx::load_index, index was built for a different target sequence, rebuild the index" << std::endl;
+      exit(1);
+    }
+
+    if (minLen < header->minLen)
+    {
+      std::cerr << "ERROR, chainx::load_index, index was built for minimum anchor length " << header->minLen << ", cannot be used with -l " << minLen << std::endl;
+      exit(1);
+    }
+
+    if (sparseness > 0 && sparseness != header->aux.K)
+    {
+      std::cerr << "ERROR, chainx::load_index, index was built with sparseness " << header->aux.K << ", cannot be used with --sparseness " << sparseness << std::endl;
+      exit(1);
+    }
+
+    const char *base = file.data();
+    target.words.map((const uint64_t*)(base + header->words.offset), header->words.count);
+    target.flags.map((const uint64_t*)(base + header->flags.offset), header->flags.count);
+    target.runs.map((const mummer::mummer::packed_run*)(base + header->runs.offset), header->runs.count);
+
+    //parameters below are placeholders, all of them are overwritten from the header
+    mummer::mummer::sparseSA sa (target, true, 1, true, false, false, 1, 0, true);
+    static_cast<mummer::mummer::sparseSA_aux&>(sa) = header->aux;
+    sa.kMerTableSize = header->kMerTableSize;
+
+    sa.SA.is_small = true;
+    sa.SA.small.map((const int*)(base + header->sa.offset), header->sa.count);
+    if (sa.hasSufLink)
+    {
+      sa.ISA.is_small = true;
+      sa.ISA.small.map((const int*)(base + header->isa.offset), header->isa.count);
+    }
+    sa.LCP.vec.map((const unsigned char*)(base + header->lcp.offset), header->lcp.count);
+    sa.LCP.M_mapped = (const mummer::mummer::vec_uchar::item_t*)(base + header->lcpLarge.offset);
+    sa.LCP.M_mapped_size = header->lcpLarge.count;
+    if (sa.hasKmer)
+      sa.KMR.map((const mummer::mummer::saTuple_t*)(base + header->kmer.offset), header->kmer.count);
+    if (sa.hasChild)
+    {
+      const int *child = (const int*)(base + header->child.offset);
+      sa.CHILD.assign(child, child + header->child.count);
+    }
+    sa.S.set_k(sa.K);
+
+    return sa;
+  }
+}
+
+#endif
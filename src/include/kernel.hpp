@@ -0,0 +1,190 @@
+#ifndef CHAINX_KERNEL_H
+#define CHAINX_KERNEL_H
+
+#include <algorithm>
+#include <limits>
+#include <cstdlib>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CHAINX_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+#include "anchors.hpp"
+
+namespace chainx
+{
+  /**
+   * @brief   minimum over predecessors i in [lo, hi) of cost[i] + gap cost + overlap cost
+   *          for anchor j, only anchors satisfying strong precedence criteria are considered
+   *          if free_ref_gap is set, gaps on reference are not penalized (semi-global end)
+   **/
+  inline int scan_predecessors(const AnchorSet &s, int lo, int hi, int j, bool free_ref_gap)
+  {
+    int find_min_cost = std::numeric_limits<int>::max();
+
+    int j_a = s.a[j], j_b = s.b[j], j_c = s.c[j], j_d = s.d[j];
+
+    for(int i=hi-1; i>=lo; i--)
+    {
+      int i_a = s.a[i], i_b = s.b[i], i_c = s.c[i], i_d = s.d[i];
+
+      if (s.cost[i] < std::numeric_limits<int>::max() && i_a < j_a && i_b < j_b && i_c < j_c && i_d < j_d)
+      {
+        int gap1 = free_ref_gap ? 0 : std::max(0, j_a - i_b - 1);
+        int gap2 = std::max(0, j_c - i_d - 1);
+        int g = std::max(gap1,gap2);
+
+        int overlap1 = std::max(0, i_b - j_a + 1);
+        int overlap2 = std::max(0, i_d - j_c + 1);
+        int o = std::abs(overlap1 - overlap2);
+
+        find_min_cost = std::min(find_min_cost, s.cost[i] + g + o);
+      }
+    }
+
+    return find_min_cost;
+  }
+
+  /**
+   * @brief   cost[i] + gap cost + overlap cost for a single pair of anchors i -> j,
+   *          int max if i does not precede j
+   **/
+  inline int predecessor_cost(const AnchorSet &s, int i, int j, bool free_ref_gap)
+  {
+    if (s.cost[i] < std::numeric_limits<int>::max() && s.a[i] < s.a[j] && s.b[i] < s.b[j] && s.c[i] < s.c[j] && s.d[i] < s.d[j])
+    {
+      int gap1 = free_ref_gap ? 0 : std::max(0, s.a[j] - s.b[i] - 1);
+      int gap2 = std::max(0, s.c[j] - s.d[i] - 1);
+      int o = std::abs(std::max(0, s.b[i] - s.a[j] + 1) - std::max(0, s.d[i] - s.c[j] + 1));
+      return s.cost[i] + std::max(gap1, gap2) + o;
+    }
+    return std::numeric_limits<int>::max();
+  }
+
+  /**
+   * @brief   minimum over predecessors i in [lo, hi), scalar fallback
+   **/
+  inline int min_predecessor_cost_scalar(const AnchorSet &s, int lo, int hi, int j, bool free_ref_gap)
+  {
+    return scan_predecessors(s, lo, hi, j, free_ref_gap);
+  }
+
+#ifdef CHAINX_X86_DISPATCH
+  /**
+   * @brief   SSE4.1 version of min_predecessor_cost_scalar, 4 predecessors per instruction
+   **/
+  __attribute__((target("sse4.1")))
+  inline int min_predecessor_cost_sse41(const AnchorSet &s, int lo, int hi, int j, bool free_ref_gap)
+  {
+    const __m128i ja = _mm_set1_epi32(s.a[j]), jb = _mm_set1_epi32(s.b[j]);
+    const __m128i jc = _mm_set1_epi32(s.c[j]), jd = _mm_set1_epi32(s.d[j]);
+    const __m128i zero = _mm_setzero_si128(), one = _mm_set1_epi32(1);
+    const __m128i inf = _mm_set1_epi32(std::numeric_limits<int>::max());
+    const __m128i gap1_mask = free_ref_gap ? zero : _mm_set1_epi32(-1);
+
+    __m128i best = inf;
+    int i = lo;
+    for(; i + 4 <= hi; i += 4)
+    {
+      __m128i ia = _mm_loadu_si128((const __m128i*)(s.a.data() + i));
+      __m128i ib = _mm_loadu_si128((const __m128i*)(s.b.data() + i));
+      __m128i ic = _mm_loadu_si128((const __m128i*)(s.c.data() + i));
+      __m128i id = _mm_loadu_si128((const __m128i*)(s.d.data() + i));
+      __m128i ci = _mm_loadu_si128((const __m128i*)(s.cost.data() + i));
+
+      //strong precedence and finite cost
+      __m128i mask = _mm_and_si128(_mm_cmpgt_epi32(ja, ia), _mm_cmpgt_epi32(jb, ib));
+      mask = _mm_and_si128(mask, _mm_and_si128(_mm_cmpgt_epi32(jc, ic), _mm_cmpgt_epi32(jd, id)));
+      mask = _mm_and_si128(mask, _mm_cmpgt_epi32(inf, ci));
+
+      __m128i gap1 = _mm_and_si128(gap1_mask, _mm_max_epi32(zero, _mm_sub_epi32(_mm_sub_epi32(ja, ib), one)));
+      __m128i gap2 = _mm_max_epi32(zero, _mm_sub_epi32(_mm_sub_epi32(jc, id), one));
+      __m128i overlap1 = _mm_max_epi32(zero, _mm_add_epi32(_mm_sub_epi32(ib, ja), one));
+      __m128i overlap2 = _mm_max_epi32(zero, _mm_add_epi32(_mm_sub_epi32(id, jc), one));
+
+      __m128i value = _mm_add_epi32(ci, _mm_add_epi32(_mm_max_epi32(gap1, gap2), _mm_abs_epi32(_mm_sub_epi32(overlap1, overlap2))));
+      best = _mm_min_epi32(best, _mm_blendv_epi8(inf, value, mask));
+    }
+
+    best = _mm_min_epi32(best, _mm_shuffle_epi32(best, _MM_SHUFFLE(1, 0, 3, 2)));
+    best = _mm_min_epi32(best, _mm_shuffle_epi32(best, _MM_SHUFFLE(2, 3, 0, 1)));
+    int find_min_cost = _mm_cvtsi128_si32(best);
+
+    //remaining predecessors
+    return std::min(find_min_cost, scan_predecessors(s, i, hi, j, free_ref_gap));
+  }
+
+  /**
+   * @brief   AVX2 version of min_predecessor_cost_scalar, 8 predecessors per instruction
+   **/
+  __attribute__((target("avx2")))
+  inline int min_predecessor_cost_avx2(const AnchorSet &s, int lo, int hi, int j, bool free_ref_gap)
+  {
+    const __m256i ja = _mm256_set1_epi32(s.a[j]), jb = _mm256_set1_epi32(s.b[j]);
+    const __m256i jc = _mm256_set1_epi32(s.c[j]), jd = _mm256_set1_epi32(s.d[j]);
+    const __m256i zero = _mm256_setzero_si256(), one = _mm256_set1_epi32(1);
+    const __m256i inf = _mm256_set1_epi32(std::numeric_limits<int>::max());
+    const __m256i gap1_mask = free_ref_gap ? zero : _mm256_set1_epi32(-1);
+
+    __m256i best = inf;
+    int i = lo;
+    for(; i + 8 <= hi; i += 8)
+    {
+      __m256i ia = _mm256_loadu_si256((const __m256i*)(s.a.data() + i));
+      __m256i ib = _mm256_loadu_si256((const __m256i*)(s.b.data() + i));
+      __m256i ic = _mm256_loadu_si256((const __m256i*)(s.c.data() + i));
+      __m256i id = _mm256_loadu_si256((const __m256i*)(s.d.data() + i));
+      __m256i ci = _mm256_loadu_si256((const __m256i*)(s.cost.data() + i));
+
+      //strong precedence and finite cost
+      __m256i mask = _mm256_and_si256(_mm256_cmpgt_epi32(ja, ia), _mm256_cmpgt_epi32(jb, ib));
+      mask = _mm256_and_si256(mask, _mm256_and_si256(_mm256_cmpgt_epi32(jc, ic), _mm256_cmpgt_epi32(jd, id)));
+      mask = _mm256_and_si256(mask, _mm256_cmpgt_epi32(inf, ci));
+
+      __m256i gap1 = _mm256_and_si256(gap1_mask, _mm256_max_epi32(zero, _mm256_sub_epi32(_mm256_sub_epi32(ja, ib), one)));
+      __m256i gap2 = _mm256_max_epi32(zero, _mm256_sub_epi32(_mm256_sub_epi32(jc, id), one));
+      __m256i overlap1 = _mm256_max_epi32(zero, _mm256_add_epi32(_mm256_sub_epi32(ib, ja), one));
+      __m256i overlap2 = _mm256_max_epi32(zero, _mm256_add_epi32(_mm256_sub_epi32(id, jc), one));
+
+      __m256i value = _mm256_add_epi32(ci, _mm256_add_epi32(_mm256_max_epi32(gap1, gap2), _mm256_abs_epi32(_mm256_sub_epi32(overlap1, overlap2))));
+      best = _mm256_min_epi32(best, _mm256_blendv_epi8(inf, value, mask));
+    }
+
+    __m128i half = _mm_min_epi32(_mm256_castsi256_si128(best), _mm256_extracti128_si256(best, 1));
+    half = _mm_min_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_min_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+    int find_min_cost = _mm_cvtsi128_si32(half);
+
+    //remaining predecessors
+    return std::min(find_min_cost, scan_predecessors(s, i, hi, j, free_ref_gap));
+  }
+#endif
+
+  typedef int (*min_predecessor_cost_fn)(const AnchorSet &, int, int, int, bool);
+
+  /**
+   * @brief   select the widest predecessor kernel supported by the running cpu
+   **/
+  inline min_predecessor_cost_fn select_min_predecessor_cost()
+  {
+#ifdef CHAINX_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return min_predecessor_cost_avx2;
+    if (__builtin_cpu_supports("sse4.1")) return min_predecessor_cost_sse41;
+#endif
+    return min_predecessor_cost_scalar;
+  }
+
+  /**
+   * @brief   dispatching wrapper around the predecessor kernels,
+   *          minimum over predecessors i in [lo, hi) of anchor j
+   **/
+  inline int min_predecessor_cost(const AnchorSet &s, int lo, int hi, int j, bool free_ref_gap)
+  {
+    static const min_predecessor_cost_fn kernel = select_min_predecessor_cost();
+    return kernel(s, lo, hi, j, free_ref_gap);
+  }
+}
+
+#endif
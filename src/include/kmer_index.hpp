@@ -0,0 +1,247 @@
+#ifndef CHAINX_KMER_INDEX_H
+#define CHAINX_KMER_INDEX_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+//third-party lib
+#include "mummer/sparseSA.hpp"
+
+//own includes
+#include "utils.hpp"
+
+namespace chainx
+{
+  const int KMER_INDEX_MAX_K = 32;      //longest k-mer used as seed
+
+  /**
+   * @brief   open-addressing hash table of the k-mers of a target, a cheaper alternative to
+   *          the suffix array for short targets. k-mers are keyed by a rolling hash of their
+   *          residues; hits are verified and extended to maximal matches. findMEM_each() and
+   *          findMUM_each() have the semantics and signatures of sparseSA, for min_len >= k.
+   *          Matches through N and other symbols are reported too, while the suffix array
+   *          skips seeds containing them, so anchors are those of the suffix array only for
+   *          targets of A, C, G and T (record separators aside), see TargetSet::nucleotides_only()
+   **/
+  class KmerIndex
+  {
+    private:
+      struct Slot
+      {
+        uint64_t key = 0;         //rolling hash of k-mer
+        uint32_t begin = 0;       //first of its positions
+        uint32_t count = 0;       //count of positions, 0 if slot is empty
+      };
+
+      std::string text;           //target residues
+      int k;
+      std::vector<Slot> table;
+      uint64_t mask = 0;          //table size - 1
+      std::vector<uint32_t> positions;    //k-mer start positions grouped by k-mer, increasing within a group
+
+      static uint64_t hash(uint64_t key)
+      {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return key;
+      }
+
+      /**
+       * @brief   call fn(pos, code) for each k-mer of s, code is a polynomial rolling hash
+       *          of its residues; distinct k-mers rarely share a code, hits are verified
+       **/
+      template <typename Fn>
+      static void for_each_kmer(const char *s, std::size_t len, int k, Fn fn)
+      {
+        const uint64_t base = 0x100000001b3ULL;
+        uint64_t drop = 1;      //base^(k-1), weight of the residue leaving the window
+        for (int i = 1; i < k; i++) drop *= base;
+
+        uint64_t code = 0;
+        for (std::size_t i = 0; i < len; i++)
+        {
+          if (i >= (std::size_t) k) code -= drop * (unsigned char) s[i - k];
+          code = code * base + (unsigned char) s[i];
+          if (i + 1 >= (std::size_t) k) fn(i + 1 - k, code);
+        }
+      }
+
+      Slot& slot_of(uint64_t code)
+      {
+        uint64_t h = hash(code) & mask;
+        while (table[h].count > 0 && table[h].key != code) h = (h + 1) & mask;
+        return table[h];
+      }
+
+      const Slot* find(uint64_t code) const
+      {
+        uint64_t h = hash(code) & mask;
+        while (table[h].count > 0)
+        {
+          if (table[h].key == code) return &table[h];
+          h = (h + 1) & mask;
+        }
+        return NULL;
+      }
+
+      /**
+       * @brief   length of the common prefix of text[r..] and P[q..], compared 8 residues
+       *          at a time, at most 'limit'
+       **/
+      long extend(long r, const char *P, long q, long limit) const
+      {
+        long l = 0;
+        const char *a = text.data() + r, *b = P + q;
+        while (l + 8 <= limit)
+        {
+          uint64_t x, y;
+          std::memcpy(&x, a + l, 8);
+          std::memcpy(&y, b + l, 8);
+          if (x != y) return l + __builtin_ctzll(x ^ y) / 8;
+          l += 8;
+        }
+        while (l < limit && a[l] == b[l]) l++;
+        return l;
+      }
+
+      /**
+       * @brief   call fn(q, hits, count) for each query position q whose k-mer occurs in the target
+       **/
+      template <typename Fn>
+      void for_each_hit(const char *P, std::size_t Plen, Fn fn) const
+      {
+        for_each_kmer(P, Plen, k, [&](std::size_t q, uint64_t code)
+        {
+          const Slot *s = find(code);
+          if (s != NULL) fn((long) q, positions.data() + s->begin, s->count);
+        });
+      }
+
+    public:
+      /**
+       * @brief   index the k-mers of target, k = min(minLen, KMER_INDEX_MAX_K)
+       **/
+      KmerIndex(const PackedSequence &target, int minLen) : k(std::min(minLen, KMER_INDEX_MAX_K))
+      {
+        target.unpack(0, target.size(), text);
+
+        std::size_t kmers = 0;
+        for_each_kmer(text.data(), text.size(), k, [&](std::size_t, uint64_t) { kmers++; });
+
+        std::size_t size = 16;
+        while (size < 2 * kmers) size <<= 1;
+        table.resize(size);
+        mask = size - 1;
+
+        //count positions of each k-mer, then place them
+        for_each_kmer(text.data(), text.size(), k, [&](std::size_t, uint64_t code)
+        {
+          Slot &s = slot_of(code);
+          s.key = code;
+          s.count++;
+        });
+
+        uint32_t sum = 0;
+        for (auto &s : table)
+        {
+          s.begin = sum;
+          sum += s.count;
+        }
+
+        positions.resize(sum);
+        for_each_kmer(text.data(), text.size(), k, [&](std::size_t pos, uint64_t code)
+        {
+          Slot &s = slot_of(code);
+          positions[s.begin++] = pos;
+        });
+        for (auto &s : table) s.begin -= s.count;
+      }
+
+      std::size_t index_size_in_bytes() const
+      {
+        return sizeof(*this) + text.size() + table.size() * sizeof(Slot) + positions.size() * sizeof(uint32_t);
+      }
+
+      /**
+       * @brief   all maximal exact matches of length >= min_len, in query order
+       **/
+      template <typename Output>
+      void findMEM_each(const char *P, std::size_t Plen, int min_len, bool flip_forward, Output out) const
+      {
+        for_each_hit(P, Plen, [&](long q, const uint32_t *hits, uint32_t count)
+        {
+          for (uint32_t h = 0; h < count; h++)
+          {
+            long r = hits[h];
+            if (q > 0 && r > 0 && P[q - 1] == text[r - 1]) continue;    //not left maximal
+            long len = extend(r, P, q, std::min<long>(text.size() - r, Plen - q));
+            if (len >= min_len) out(mummer::mummer::match_t(r, !flip_forward ? q : (long)Plen - 1 - q, len));
+          }
+        });
+      }
+
+      /**
+       * @brief   maximal unique matches of length >= min_len, filtered as by sparseSA:
+       *          MEMs occurring once in the target, not contained in another one on the
+       *          target, in target order
+       **/
+      template <typename Output>
+      void findMUM_each(const char *P, std::size_t Plen, int min_len, bool flip_forward, Output out) const
+      {
+        std::vector<mummer::mummer::match_t> matches;
+
+        //match lengths of the hits at the previous query position; a hit that is not left
+        //maximal continues a hit there, and is one residue shorter
+        long prev_q = -2;
+        const uint32_t *prev_hits = NULL;
+        uint32_t prev_count = 0;
+        std::vector<long> prev_lens, lens;
+
+        for_each_hit(P, Plen, [&](long q, const uint32_t *hits, uint32_t count)
+        {
+          //the longest match at q counts if it occurs once in the target and is left maximal
+          long longest = 0, at = -1;
+          int occurrences = 0;
+          lens.resize(count);
+          for (uint32_t h = 0, j = 0; h < count; h++)
+          {
+            long r = hits[h], len;
+            bool left_maximal = q == 0 || r == 0 || P[q - 1] != text[r - 1];
+            while (j < prev_count && (long) prev_hits[j] < r - 1) j++;
+            if (!left_maximal && prev_q == q - 1 && j < prev_count && (long) prev_hits[j] == r - 1)
+              len = prev_lens[j] - 1;
+            else
+              len = extend(r, P, q, std::min<long>(text.size() - r, Plen - q));
+            lens[h] = len;
+
+            if (len > longest)
+            {
+              longest = len;
+              at = left_maximal ? r : -1;
+              occurrences = 1;
+            }
+            else if (len == longest)
+              occurrences++;
+          }
+
+          if (longest >= min_len && occurrences == 1 && at >= 0)
+            matches.emplace_back(at, !flip_forward ? q : (long)Plen - 1 - q, longest);
+
+          prev_q = q;
+          prev_hits = hits;
+          prev_count = count;
+          prev_lens.swap(lens);
+        });
+
+        mummer::mummer::cleanMUMcand(matches, out);
+      }
+  };
+}
+
+#endif
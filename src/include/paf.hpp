@@ -0,0 +1,77 @@
+#ifndef CHAINX_PAF_H
+#define CHAINX_PAF_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "anchors.hpp"
+#include "align.hpp"
+
+namespace chainx
+{
+  /**
+   * @brief   print an optimal chain as one PAF line (0-based, end exclusive coordinates)
+   *          query is aligned end-to-end; target interval is the whole target in global
+   *          mode, and the interval implied by the first and last chained anchors
+   *          (extended by the unaligned query ends) in semi-global mode
+   *          tags: ed:i: distance, cn:i: count of chained anchors,
+   *                ch:Z: chained anchors as <target start>,<query start>,<length> separated by ';'
+   *          if aln is given, target interval, matches and block length are taken from
+   *          the alignment, and NM:i: (exact edit distance) and cg:Z: (CIGAR) are appended
+   * @param   transposed  anchors in s are keyed on query, i.e., <qry, ref, len>
+   * @param   reverse     chain is of the reverse complemented query, strand is reported as '-'
+   *                      and ch:Z: query coordinates are on the reverse complement
+   **/
+  inline void write_paf(std::ostream &os, const std::string &qname, int len_qry, const std::string &tname, int len_ref,
+      const AnchorSet &s, const std::vector<int> &chain, bool transposed, bool semiglobal, int distance,
+      const ChainAlignment *aln = NULL, bool reverse = false)
+  {
+    const aligned_ivec &ref_start = transposed ? s.c : s.a;
+    const aligned_ivec &qry_start = transposed ? s.a : s.c;
+    auto length = [&](int k) { return s.b[k] - s.a[k] + 1; };
+
+    int t_start = 0, t_end = len_ref;
+    if (semiglobal)
+    {
+      if (chain.empty())
+        t_end = 0;
+      else
+      {
+        int first = chain.front(), last = chain.back();
+        t_start = std::max(0, ref_start[first] - qry_start[first]);
+        t_end = std::min(len_ref, ref_start[last] + length(last) + (len_qry - qry_start[last] - length(last)));
+      }
+    }
+
+    //query residues covered by chained anchors
+    int matches = 0, covered_end = 0;
+    for (int k : chain)
+    {
+      matches += std::max(0, qry_start[k] + length(k) - std::max(qry_start[k], covered_end));
+      covered_end = std::max(covered_end, qry_start[k] + length(k));
+    }
+
+    int block = std::max(len_qry, t_end - t_start);
+    if (aln != NULL)
+    {
+      t_start = aln->t_start;
+      t_end = aln->t_end;
+      matches = aln->matches;
+      block = aln->columns;
+    }
+
+    os << qname << "\t" << len_qry << "\t" << 0 << "\t" << len_qry << "\t" << (reverse ? "-" : "+") << "\t" \
+      << tname << "\t" << len_ref << "\t" << t_start << "\t" << t_end << "\t" \
+      << matches << "\t" << block << "\t255" \
+      << "\ted:i:" << distance << "\tcn:i:" << chain.size() << "\tch:Z:";
+
+    for (std::size_t k = 0; k < chain.size(); k++)
+      os << (k ? ";" : "") << ref_start[chain[k]] << "," << qry_start[chain[k]] << "," << length(chain[k]);
+    if (aln != NULL) os << "\tNM:i:" << aln->edit_distance << "\tcg:Z:" << aln->cigar;
+    os << "\n";
+  }
+}
+
+#endif
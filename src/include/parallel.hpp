@@ -0,0 +1,278 @@
+#ifndef CHAINX_PARALLEL_H
+#define CHAINX_PARALLEL_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <algorithm>
+
+namespace chainx
+{
+  /**
+   * @brief   run fn(worker, index) for every index in [0, n) using 'threads' workers
+   *          work stealing: each worker starts with a contiguous block of indices and takes
+   *          items from its front; an idle worker steals the back half of the largest
+   *          remaining block of another worker. Worker 0 runs on the calling thread
+   **/
+  template <typename Fn>
+  void parallel_for(std::size_t n, int threads, Fn fn)
+  {
+    threads = std::max(1, std::min<int>(threads, std::max<std::size_t>(n, 1)));
+
+    if (threads == 1)
+    {
+      for (std::size_t i = 0; i < n; i++) fn(0, i);
+      return;
+    }
+
+    struct Block
+    {
+      std::mutex lock;
+      std::size_t begin = 0;
+      std::size_t end = 0;
+    };
+
+    std::vector<Block> blocks(threads);
+    for (int t = 0; t < threads; t++)
+    {
+      blocks[t].begin = n * t / threads;
+      blocks[t].end = n * (t + 1) / threads;
+    }
+
+    auto worker = [&](int t)
+    {
+      while (true)
+      {
+        std::size_t item = n;
+        {
+          std::lock_guard<std::mutex> guard(blocks[t].lock);
+          if (blocks[t].begin < blocks[t].end) item = blocks[t].begin++;
+        }
+
+        if (item < n)
+        {
+          fn(t, item);
+          continue;
+        }
+
+        //own block is empty, steal from the largest block
+        int victim = -1;
+        std::size_t largest = 0;
+        for (int v = 0; v < threads; v++)
+        {
+          if (v == t) continue;
+          std::lock_guard<std::mutex> guard(blocks[v].lock);
+          if (blocks[v].end - blocks[v].begin > largest)
+          {
+            largest = blocks[v].end - blocks[v].begin;
+            victim = v;
+          }
+        }
+
+        if (victim == -1) return; //no work left anywhere
+
+        std::size_t steal_begin, steal_end;
+        {
+          std::lock_guard<std::mutex> guard(blocks[victim].lock);
+          if (blocks[victim].begin >= blocks[victim].end) continue; //lost the race, look again
+          steal_end = blocks[victim].end;
+          steal_begin = blocks[victim].begin + (blocks[victim].end - blocks[victim].begin) / 2;
+          blocks[victim].end = steal_begin;
+        }
+
+        std::lock_guard<std::mutex> guard(blocks[t].lock);
+        blocks[t].begin = steal_begin;
+        blocks[t].end = steal_end;
+      }
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++) pool.emplace_back(worker, t);
+    worker(0);
+    for (auto &th : pool) th.join();
+  }
+
+  /**
+   * @brief   blocking FIFO queue with a capacity limit, used to hand items between
+   *          pipeline stages; after close(), push is ignored and pop drains what is left
+   **/
+  template <typename T>
+  class BoundedQueue
+  {
+    private:
+      std::mutex lock;
+      std::condition_variable not_empty, not_full;
+      std::deque<T> items;
+      std::size_t capacity;
+      bool closed = false;
+
+    public:
+      BoundedQueue(std::size_t capacity) : capacity(std::max<std::size_t>(capacity, 1)) {}
+
+      /**
+       * @brief   append item, waits while queue is full
+       **/
+      void push(T item)
+      {
+        std::unique_lock<std::mutex> guard(lock);
+        not_full.wait(guard, [&] { return closed || items.size() < capacity; });
+        if (closed) return;
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+      }
+
+      /**
+       * @brief   remove oldest item, waits while queue is empty, false once closed and empty
+       **/
+      bool pop(T &item)
+      {
+        std::unique_lock<std::mutex> guard(lock);
+        not_empty.wait(guard, [&] { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+      }
+
+      void close()
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        closed = true;
+        not_empty.notify_all();
+        not_full.notify_all();
+      }
+  };
+
+  /**
+   * @brief   text written to stdout and stderr while processing one item, kept in the
+   *          order it was written so that it can be replayed later
+   **/
+  class Transcript
+  {
+    private:
+      std::vector<std::pair<int, std::string>> parts;   //<stream (1 = stdout, 2 = stderr), text>
+      std::ostringstream current;
+      int current_stream = 2;
+
+      std::ostream& select(int stream)
+      {
+        if (stream != current_stream)
+        {
+          flush();
+          current_stream = stream;
+        }
+        return current;
+      }
+
+      void flush()
+      {
+        if (current.tellp() > 0)
+        {
+          parts.emplace_back(current_stream, current.str());
+          current.str("");
+        }
+      }
+
+    public:
+      std::ostream& out() { return select(1); }
+      std::ostream& err() { return select(2); }
+
+      /**
+       * @brief   hand over buffered text as <stream, text> parts and reset
+       **/
+      std::vector<std::pair<int, std::string>> take()
+      {
+        flush();
+        std::vector<std::pair<int, std::string>> result;
+        result.swap(parts);
+        return result;
+      }
+  };
+
+  /**
+   * @brief   writes transcript parts to stdout and stderr on its own thread, so that
+   *          workers do not wait for output streams; parts are written in arrival order
+   **/
+  class OutputWriter
+  {
+    private:
+      BoundedQueue<std::vector<std::pair<int, std::string>>> queue;
+      std::thread writer;
+
+    public:
+      OutputWriter(std::size_t capacity = 1024) : queue(capacity)
+      {
+        writer = std::thread([this]
+        {
+          std::vector<std::pair<int, std::string>> parts;
+          while (queue.pop(parts))
+            for (auto &p : parts)
+              (p.first == 1 ? std::cout : std::cerr) << p.second;
+        });
+      }
+
+      OutputWriter(const OutputWriter &) = delete;
+      OutputWriter& operator=(const OutputWriter &) = delete;
+
+      ~OutputWriter() { close(); }
+
+      /**
+       * @brief   write everything queued so far and stop the writer thread
+       **/
+      void close()
+      {
+        queue.close();
+        if (writer.joinable()) writer.join();
+        std::cout.flush();
+      }
+
+      void write(std::vector<std::pair<int, std::string>> parts) { queue.push(std::move(parts)); }
+  };
+
+  /**
+   * @brief   collects transcripts produced per item by parallel workers, and writes
+   *          them in item order as soon as all preceding items are complete,
+   *          directly or through writer if one is given
+   **/
+  class OrderedOutput
+  {
+    private:
+      std::mutex lock;
+      std::vector<std::vector<std::pair<int, std::string>>> pending;
+      std::vector<char> ready;
+      std::size_t next = 0;
+      OutputWriter *writer;
+
+    public:
+      OrderedOutput(std::size_t n, OutputWriter *writer = NULL) : pending(n), ready(n, 0), writer(writer) {}
+
+      void emit(std::size_t item, Transcript &transcript)
+      {
+        std::vector<std::pair<int, std::string>> parts = transcript.take();
+
+        std::lock_guard<std::mutex> guard(lock);
+        pending[item].swap(parts);
+        ready[item] = 1;
+
+        while (next < ready.size() && ready[next])
+        {
+          if (writer)
+            writer->write(std::move(pending[next]));
+          else
+            for (auto &p : pending[next])
+              (p.first == 1 ? std::cout : std::cerr) << p.second;
+          std::vector<std::pair<int, std::string>>().swap(pending[next]);
+          next++;
+        }
+      }
+  };
+}
+
+#endif
@@ -12,13 +12,45 @@ namespace chainx
   {
     std::string tfile;                //target sequence file (fasta/q)
     std::string qfile;                //file specifying query sequences
+    std::string ifile;                //prefix of prebuilt target index files (optional)
     int minLen = 20;                  //minimum MEM to consider
     std::string mode;                 //"g" -> global, "sg" -> semi-global
     std::string matchType = "MUM";    //all MEMs or just consider MUMs (i.e., single occurence in query and ref)
     bool naive = false;               //use naive 2d dynamic programming algorithm similar to edit distance
+    bool rmq = false;                 //use range-minimum-query based chaining engine, O(n log^2 n) time
+    bool incremental = false;         //reuse costs of previous pass when distance bound is raised
+    int threads = 1;                  //count of worker threads
+    int maxIndexes = 0;               //suffix arrays kept in memory at once in all2all mode (0 = thread count)
     bool all2all = false;             //compute all to all global distance among query sequences
+    bool chain = false;               //print optimal chain of each query in PAF format
+    bool align = false;               //align each query along its optimal chain, implies chain
+    bool exact = false;               //compute exact edit distance with edlib, banded by chaining cost
+    bool bothStrands = false;         //chain reverse complement of each query too, report the better strand
+    int maxDistance = -1;             //report all target records within this distance (-1 = best record only)
+    int sparseness = 0;               //suffix array keeps every K-th suffix (0 = not given: 1, or as recorded in index)
+    int kmerIndexMax = 1 << 18;       //targets up to this length get a k-mer hash table instead of a suffix array
+    int window = 10;                  //minimizer window size, minimizer backend only
+    int maxOcc = 0;                   //drop anchors of query positions with more than this many anchors (0 = no cap)
+    int sdust = 0;                    //drop anchors in low-complexity query regions of sdust score above this (0 = off)
   };
 
+  /**
+   * @brief   validate sparseness against minimum anchor length; if not given, suffix arrays
+   *          built here keep every suffix, and an index loaded from param.ifile (if 'loads')
+   *          keeps the sparseness it was built with
+   **/
+  inline void checkSparseness(Parameters &param, const std::string &caller, bool loads)
+  {
+    if (param.sparseness == 0 && !(loads && !param.ifile.empty())) param.sparseness = 1;
+    if (param.sparseness > 0) std::cerr << "INFO, " << caller << "::parseandSave, suffix array sparseness = " << param.sparseness << std::endl;
+
+    if (param.sparseness < 0 || (param.sparseness > 1 && param.sparseness >= param.minLen))
+    {
+      std::cerr << "ERROR, " << caller << "::parseandSave, sparseness must be positive and, unless 1, smaller than the minimum anchor length" << std::endl;
+      exit(1);
+    }
+  }
+
   void parseandSave_chainx(int argc, char** argv, Parameters &param)
   {
     //define all arguments
@@ -28,25 +60,99 @@ namespace chainx
        clipp::option("-a") & (clipp::required("MEM").set(param.matchType) | clipp::required("MUM").set(param.matchType)).doc("anchor type (default = MUM)"),
        clipp::option("--all2all").set(param.all2all).doc("output all to all global distances among query sequences in phylip format"),
        clipp::option("--naive").set(param.naive).doc("use slow 2d dynamic programming algorithm to obtain exact cost"),
+       clipp::option("--rmq").set(param.rmq).doc("use range-minimum-query based chaining, O(n log^2 n) time irrespective of divergence"),
+       clipp::option("--incremental").set(param.incremental).doc("reuse costs of previous pass when distance bound is revised"),
+       clipp::option("--chain").set(param.chain).doc("print optimal anchor chain and implied target interval of each query in PAF format"),
+       clipp::option("--align").set(param.align).doc("also align each query along its optimal chain with edlib, adds exact distance and CIGAR to --chain output"),
+       clipp::option("--exact").set(param.exact).doc("compute exact edit distance with edlib, using chaining cost as its band"),
+       clipp::option("--both-strands").set(param.bothStrands).doc("also chain reverse complement of each query, report the strand with smaller cost"),
+       clipp::option("--max-distance") & clipp::value("distance", param.maxDistance).doc("report every target record (and strand) within this distance instead of the best one"),
+       clipp::option("--threads") & clipp::value("count", param.threads).doc("count of worker threads used for queries and to build the suffix array (default = 1)"),
+       clipp::option("--max-indexes") & clipp::value("indexes", param.maxIndexes).doc("suffix arrays kept in memory at once with --all2all (default = thread count)"),
+       clipp::option("--sparseness") & clipp::value("K", param.sparseness).doc("index every K-th suffix of the target only, K < length; same anchors on A, C, G and T, possibly fewer near N (default = 1, or as built with -i)"),
+       clipp::option("--kmer-index-max") & clipp::value("residues", param.kmerIndexMax).doc("targets of A, C, G and T of at most this length are indexed by a hash table of k-mers instead of a suffix array (default = 262144, 0 = never)"),
+       clipp::option("--max-occ") & clipp::value("occurrences", param.maxOcc).doc("drop anchors of query positions with more than this many anchors (default = 0, no cap)"),
+       clipp::option("--sdust") & clipp::value("score", param.sdust).doc("drop anchors in low-complexity query regions of sdust score above this, e.g., 20 (default = 0, off)"),
        clipp::required("-m") & (clipp::required("g").set(param.mode) | clipp::required("sg").set(param.mode)).doc("distance function (e.g., global or semi-global)"),
        clipp::required("-q") & clipp::value("qpath", param.qfile).doc("query sequences in fasta or fastq format"),
-       clipp::required("-t") & clipp::value("tpath", param.tfile).doc("target sequence in fasta format")
+       clipp::required("-t") & clipp::value("tpath", param.tfile).doc("target sequences in fasta format, records are indexed together"),
+       clipp::option("-i") & clipp::value("index", param.ifile).doc("load target index built with 'chainX index' instead of computing it")
       );
 
     if(!clipp::parse(argc, argv, cli))
     {
       //print help page
       clipp::operator<<(std::cout, clipp::make_man_page(cli, argv[0])) << std::endl;
+      std::cout << "Use '" << argv[0] << " index' to save a target index to disk." << std::endl;
       exit(1);
     }
 
     //print all input parameters
     std::cerr << "INFO, chainx::parseandSave, target sequence file = " << param.tfile << std::endl;
+    if (!param.ifile.empty()) std::cerr << "INFO, chainx::parseandSave, target index = " << param.ifile << std::endl;
     std::cerr << "INFO, chainx::parseandSave, query sequences file = " << param.qfile << std::endl;
-    if (!param.naive) std::cerr << "INFO, chainx::parseandSave, mode = " << param.mode << std::endl;
+    if (!param.naive && !param.rmq) std::cerr << "INFO, chainx::parseandSave, mode = " << param.mode << std::endl;
     if (param.naive) std::cerr << "INFO, chainx::parseandSave, mode = " << param.mode << " (naive 2d DP)" << std::endl;
+    if (!param.naive && param.rmq) std::cerr << "INFO, chainx::parseandSave, mode = " << param.mode << " (range-minimum-query chaining)" << std::endl;
+    if (!param.naive && !param.rmq && param.incremental) std::cerr << "INFO, chainx::parseandSave, incremental bound revision enabled" << std::endl;
     if (param.all2all) std::cerr << "INFO, chainx::parseandSave, computing all-to-all distances" << std::endl;
+    if (param.align) param.chain = true;
+    if (param.chain) std::cerr << "INFO, chainx::parseandSave, printing optimal chains in PAF format" << std::endl;
+    if (param.align) std::cerr << "INFO, chainx::parseandSave, aligning gaps between chained anchors" << std::endl;
+    if (param.exact) std::cerr << "INFO, chainx::parseandSave, computing exact edit distance banded by chaining cost" << std::endl;
+    if (param.bothStrands) std::cerr << "INFO, chainx::parseandSave, chaining both strands of each query" << std::endl;
+    if (param.maxDistance >= 0) std::cerr << "INFO, chainx::parseandSave, reporting target records within distance " << param.maxDistance << std::endl;
     std::cerr << "INFO, chainx::parseandSave, anchor : minimim length = " << param.minLen << ", type = " << param.matchType << std::endl;
+    std::cerr << "INFO, chainx::parseandSave, threads = " << param.threads << std::endl;
+
+    if (param.threads < 1)
+    {
+      std::cerr << "ERROR, chainx::parseandSave, thread count must be at least 1" << std::endl;
+      exit(1);
+    }
+
+    if (param.chain && (param.naive || param.all2all))
+    {
+      std::cerr << "ERROR, chainx::parseandSave, chain output [ --chain, --align ] can not be used with --naive or --all2all" << std::endl;
+      exit(1);
+    }
+
+    if (param.exact && (param.chain || param.all2all))
+    {
+      std::cerr << "ERROR, chainx::parseandSave, exact distance [ --exact ] can not be used with --chain, --align or --all2all" << std::endl;
+      exit(1);
+    }
+
+    if (param.bothStrands && param.all2all)
+    {
+      std::cerr << "ERROR, chainx::parseandSave, both strands [ --both-strands ] can not be used with --all2all" << std::endl;
+      exit(1);
+    }
+
+    if (param.maxDistance >= 0 && param.all2all)
+    {
+      std::cerr << "ERROR, chainx::parseandSave, distance threshold [ --max-distance ] can not be used with --all2all" << std::endl;
+      exit(1);
+    }
+
+    if (param.maxIndexes <= 0) param.maxIndexes = param.threads;
+    if (param.all2all) std::cerr << "INFO, chainx::parseandSave, suffix arrays in memory at once <= " << param.maxIndexes << std::endl;
+    checkSparseness(param, "chainx", true);
+    if (param.kmerIndexMax > 0) std::cerr << "INFO, chainx::parseandSave, k-mer index for targets up to " << param.kmerIndexMax << " residues" << std::endl;
+    if (param.maxOcc > 0) std::cerr << "INFO, chainx::parseandSave, anchors per query position <= " << param.maxOcc << std::endl;
+    if (param.sdust > 0) std::cerr << "INFO, chainx::parseandSave, masking low-complexity query regions, sdust score > " << param.sdust << std::endl;
+
+    if (param.maxOcc < 0 || param.sdust < 0)
+    {
+      std::cerr << "ERROR, chainx::parseandSave, occurrence cap and sdust score must not be negative" << std::endl;
+      exit(1);
+    }
+
+    if ((param.maxOcc > 0 || param.sdust > 0) && param.all2all)
+    {
+      std::cerr << "ERROR, chainx::parseandSave, anchor filters [ --max-occ, --sdust ] can not be used with --all2all" << std::endl;
+      exit(1);
+    }
 
     if (! exists(param.tfile))
     {
@@ -73,6 +179,52 @@ namespace chainx
         std::cerr << "ERROR, chainx::parseandSave, only global distance function [ -m g ] can be used in all-to-all mode" << std::endl;
         exit(1);
       }
+
+      if (!param.ifile.empty())
+      {
+        std::cerr << "ERROR, chainx::parseandSave, target index [ -i ] can not be used in all-to-all mode" << std::endl;
+        exit(1);
+      }
+    }
+  }
+
+  void parseandSave_index(int argc, char** argv, Parameters &param)
+  {
+    //define all arguments
+    auto cli =
+      (
+       clipp::command("index"),
+       clipp::option("-l") & clipp::value("length", param.minLen).doc("minimum anchor match length the index will be used with (default = 20)"),
+       clipp::option("--threads") & clipp::value("count", param.threads).doc("count of threads used to build the suffix array (default = 1)"),
+       clipp::option("--sparseness") & clipp::value("K", param.sparseness).doc("index every K-th suffix of the target only, K < length; same anchors on A, C, G and T, possibly fewer near N (default = 1)"),
+       clipp::required("-t") & clipp::value("tpath", param.tfile).doc("target sequences in fasta format, records are indexed together"),
+       clipp::required("-i") & clipp::value("index", param.ifile).doc("prefix of index files to write")
+      );
+
+    if(!clipp::parse(argc, argv, cli))
+    {
+      //print help page
+      clipp::operator<<(std::cout, clipp::make_man_page(cli, argv[0])) << std::endl;
+      exit(1);
+    }
+
+    //print all input parameters
+    std::cerr << "INFO, chainx::parseandSave, target sequence file = " << param.tfile << std::endl;
+    std::cerr << "INFO, chainx::parseandSave, target index = " << param.ifile << std::endl;
+    std::cerr << "INFO, chainx::parseandSave, anchor : minimim length = " << param.minLen << std::endl;
+    std::cerr << "INFO, chainx::parseandSave, threads = " << param.threads << std::endl;
+    checkSparseness(param, "chainx", false);
+
+    if (param.threads < 1)
+    {
+      std::cerr << "ERROR, chainx::parseandSave, thread count must be at least 1" << std::endl;
+      exit(1);
+    }
+
+    if (! exists(param.tfile))
+    {
+      std::cerr << "ERROR, chainx::parseandSave, target sequence file could not be opened" << std::endl;
+      exit(1);
     }
   }
 
@@ -82,6 +234,7 @@ namespace chainx
     auto cli =
       (
        clipp::option("--all2all").set(param.all2all).doc("output all to all global distances among query sequences in phylip format"),
+       clipp::option("--threads") & clipp::value("count", param.threads).doc("count of worker threads used for queries or pairs (default = 1)"),
        clipp::required("-m") & (clipp::required("g").set(param.mode) | clipp::required("sg").set(param.mode)).doc("distance function (e.g., global or semi-global)"),
        clipp::required("-q") & clipp::value("qpath", param.qfile).doc("query sequences in fasta or fastq format"),
        clipp::required("-t") & clipp::value("tpath", param.tfile).doc("target sequence in fasta format")
@@ -99,6 +252,13 @@ namespace chainx
     std::cerr << "INFO, chainx::parseandSave, query sequences file = " << param.qfile << std::endl;
     std::cerr << "INFO, chainx::parseandSave, mode = " << param.mode << std::endl;
     if (param.all2all) std::cerr << "INFO, chainx::parseandSave, computing all-to-all distances" << std::endl;
+    std::cerr << "INFO, chainx::parseandSave, threads = " << param.threads << std::endl;
+
+    if (param.threads < 1)
+    {
+      std::cerr << "ERROR, chainx::parseandSave, thread count must be at least 1" << std::endl;
+      exit(1);
+    }
 
     if (! exists(param.tfile))
     {
@@ -135,8 +295,11 @@ namespace chainx
       (
        clipp::option("-l") & clipp::value("length", param.minLen).doc("minimum anchor match length (default = 20)"),
        clipp::option("-a") & (clipp::required("MEM").set(param.matchType) | clipp::required("MUM").set(param.matchType)).doc("anchor type (default = MUM)"),
+       clipp::option("--sparseness") & clipp::value("K", param.sparseness).doc("index every K-th suffix of the target only, K < length; same anchors on A, C, G and T, possibly fewer near N (default = 1, or as built with -i)"),
+       clipp::option("--kmer-index-max") & clipp::value("residues", param.kmerIndexMax).doc("targets of A, C, G and T of at most this length are indexed by a hash table of k-mers instead of a suffix array (default = 262144, 0 = never)"),
        clipp::required("-q") & clipp::value("qpath", param.qfile).doc("query sequences in fasta or fastq format"),
-       clipp::required("-t") & clipp::value("tpath", param.tfile).doc("target sequence in fasta format")
+       clipp::required("-t") & clipp::value("tpath", param.tfile).doc("target sequences in fasta format, records are indexed together"),
+       clipp::option("-i") & clipp::value("index", param.ifile).doc("load target index built with 'chainX index' instead of computing it")
       );
 
     if(!clipp::parse(argc, argv, cli))
@@ -148,8 +311,11 @@ namespace chainx
 
     //print all input parameters
     std::cerr << "INFO, printanchors::parseandSave, target sequence file = " << param.tfile << std::endl;
+    if (!param.ifile.empty()) std::cerr << "INFO, printanchors::parseandSave, target index = " << param.ifile << std::endl;
     std::cerr << "INFO, printanchors::parseandSave, query sequences file = " << param.qfile << std::endl;
     std::cerr << "INFO, printanchors::parseandSave, anchor : minimim length = " << param.minLen << ", type = " << param.matchType << std::endl;
+    checkSparseness(param, "printanchors", true);
+    if (param.kmerIndexMax > 0) std::cerr << "INFO, printanchors::parseandSave, k-mer index for targets up to " << param.kmerIndexMax << " residues" << std::endl;
 
     if (! exists(param.tfile))
     {
@@ -163,6 +329,70 @@ namespace chainx
       exit(1);
     }
   }
+
+  void parseandSave_minimizer(int argc, char** argv, Parameters &param)
+  {
+    //define all arguments
+    auto cli =
+      (
+       clipp::option("-l") & clipp::value("length", param.minLen).doc("minimizer k-mer length, i.e., anchor length (default = 20, at most 28)"),
+       clipp::option("-w") & clipp::value("window", param.window).doc("minimizer window size (default = 10)"),
+       clipp::option("--max-occ") & clipp::value("occurrences", param.maxOcc).doc("ignore minimizers occurring more than this many times in the target (default = 0, no cap)"),
+       clipp::option("--incremental").set(param.incremental).doc("reuse costs of previous pass when distance bound is revised"),
+       clipp::option("--chain").set(param.chain).doc("print optimal anchor chain and implied target interval of each query in PAF format"),
+       clipp::option("--threads") & clipp::value("count", param.threads).doc("count of worker threads used for queries and to build the minimizer index (default = 1)"),
+       clipp::required("-m") & (clipp::required("g").set(param.mode) | clipp::required("sg").set(param.mode)).doc("distance function (e.g., global or semi-global)"),
+       clipp::required("-q") & clipp::value("qpath", param.qfile).doc("query sequences in fasta or fastq format"),
+       clipp::required("-t") & clipp::value("tpath", param.tfile).doc("target sequences in fasta format")
+      );
+
+    if(!clipp::parse(argc, argv, cli))
+    {
+      //print help page
+      clipp::operator<<(std::cout, clipp::make_man_page(cli, argv[0])) << std::endl;
+      exit(1);
+    }
+
+    //print all input parameters
+    std::cerr << "INFO, chainx-minimizer::parseandSave, target sequence file = " << param.tfile << std::endl;
+    std::cerr << "INFO, chainx-minimizer::parseandSave, query sequences file = " << param.qfile << std::endl;
+    std::cerr << "INFO, chainx-minimizer::parseandSave, mode = " << param.mode << std::endl;
+    if (param.incremental) std::cerr << "INFO, chainx-minimizer::parseandSave, incremental bound revision enabled" << std::endl;
+    if (param.chain) std::cerr << "INFO, chainx-minimizer::parseandSave, printing optimal chains in PAF format" << std::endl;
+    std::cerr << "INFO, chainx-minimizer::parseandSave, anchor : minimizer k = " << param.minLen << ", w = " << param.window << std::endl;
+    std::cerr << "INFO, chainx-minimizer::parseandSave, threads = " << param.threads << std::endl;
+    if (param.maxOcc > 0) std::cerr << "INFO, chainx-minimizer::parseandSave, minimizer occurrences <= " << param.maxOcc << std::endl;
+
+    if (param.threads < 1)
+    {
+      std::cerr << "ERROR, chainx-minimizer::parseandSave, thread count must be at least 1" << std::endl;
+      exit(1);
+    }
+
+    if (param.maxOcc < 0)
+    {
+      std::cerr << "ERROR, chainx-minimizer::parseandSave, occurrence cap must not be negative" << std::endl;
+      exit(1);
+    }
+
+    if (param.minLen < 1 || param.minLen > 28 || param.window < 1 || param.window >= 256)
+    {
+      std::cerr << "ERROR, chainx-minimizer::parseandSave, k-mer length must be in [1, 28] and window size in [1, 255]" << std::endl;
+      exit(1);
+    }
+
+    if (! exists(param.tfile))
+    {
+      std::cerr << "ERROR, chainx-minimizer::parseandSave, target sequence file could not be opened" << std::endl;
+      exit(1);
+    }
+
+    if (! exists(param.qfile))
+    {
+      std::cerr << "ERROR, chainx-minimizer::parseandSave, query sequence file could not be opened" << std::endl;
+      exit(1);
+    }
+  }
 }
 
 #endif
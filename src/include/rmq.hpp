@@ -0,0 +1,65 @@
+#ifndef CHAINX_RMQ_H
+#define CHAINX_RMQ_H
+
+#include <vector>
+#include <limits>
+#include <utility>
+#include <algorithm>
+
+namespace chainx
+{
+  /**
+   * @brief   bottom-up segment tree over a fixed number of leaves,
+   *          supports point assignment and range-minimum queries in O(log n)
+   *          each leaf holds a value and the id it came from, the minimum is reported with its id
+   *          (smaller id on ties); empty leaves hold std::numeric_limits<int>::max() and id -1
+   **/
+  class RangeMinTree
+  {
+    private:
+      typedef std::pair<int, int> Entry;    //<value, id>
+
+      int size;                   //number of leaves
+      std::vector<Entry> tree;    //tree[1] is root, leaves start at offset size
+
+    public:
+      RangeMinTree() : size(0) {}
+
+      /**
+       * @brief   resize to n leaves and clear all values
+       **/
+      void reset(int n)
+      {
+        size = std::max(n, 1);
+        tree.assign(2 * size, Entry(std::numeric_limits<int>::max(), -1));
+      }
+
+      /**
+       * @brief   assign value with its id at leaf pos (use int max to erase)
+       **/
+      void set(int pos, int value, int id = -1)
+      {
+        pos += size;
+        tree[pos] = Entry(value, id);
+        for (pos >>= 1; pos >= 1; pos >>= 1)
+          tree[pos] = std::min(tree[2*pos], tree[2*pos+1]);
+      }
+
+      /**
+       * @brief   minimum over leaves [l, r), its id is stored in *id if given
+       **/
+      int query(int l, int r, int *id = NULL) const
+      {
+        Entry result(std::numeric_limits<int>::max(), -1);
+        for (l += size, r += size; l < r; l >>= 1, r >>= 1)
+        {
+          if (l & 1) result = std::min(result, tree[l++]);
+          if (r & 1) result = std::min(result, tree[--r]);
+        }
+        if (id) *id = result.second;
+        return result.first;
+      }
+  };
+}
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef CHAINX_TARGET_H
+#define CHAINX_TARGET_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <mutex>
+
+//own includes
+#include "utils.hpp"
+
+namespace chainx
+{
+  const char TARGET_SEPARATOR = '`';    //never occurs in upper case queries, so no match spans two records
+
+  /**
+   * @brief   target records concatenated into one packed sequence, so that a single suffix
+   *          array (and index file) covers all of them; a single record is used as is
+   **/
+  class TargetSet
+  {
+    private:
+      mutable std::once_flag unpacked_once;
+      mutable std::string unpacked;     //whole sequence as characters, built on first use
+
+    public:
+      PackedSequence seq;               //records separated by TARGET_SEPARATOR
+      std::vector<std::string> ids;
+      std::vector<int> starts;          //offset of each record in seq
+      std::vector<int> lengths;
+
+      /**
+       * @brief   concatenate records, their buffers are released as they are copied
+       **/
+      TargetSet(std::vector<PackedSequence> &records, std::vector<std::string> &ids_) : ids(ids_)
+      {
+        if (records.size() == 1)
+        {
+          starts.push_back(0);
+          lengths.push_back(records[0].size());
+          std::swap(seq, records[0]);
+          return;
+        }
+
+        for (std::size_t k = 0; k < records.size(); k++)
+        {
+          if (k > 0) seq.push_back(TARGET_SEPARATOR);
+          starts.push_back(seq.size());
+          lengths.push_back(records[k].size());
+          seq.append(records[k]);
+          records[k] = PackedSequence();
+        }
+      }
+
+      TargetSet(const TargetSet &) = delete;
+      TargetSet& operator=(const TargetSet &) = delete;
+
+      std::size_t size() const { return starts.size(); }
+
+      /**
+       * @brief   count of residues in all records, without separators
+       **/
+      std::size_t residues() const { return seq.size() - (size() - 1); }
+
+      /**
+       * @brief   true if all records are made of A, C, G and T only, i.e., the only residues
+       *          outside the 2-bit code are record separators
+       **/
+      bool nucleotides_only() const
+      {
+        for (std::size_t k = 0; k < seq.runs.size(); k++)
+          if (seq.runs[k].c != TARGET_SEPARATOR) return false;
+        return true;
+      }
+
+      /**
+       * @brief   record containing position pos of seq, by binary search over record starts
+       **/
+      int locate(int pos) const
+      {
+        return std::upper_bound(starts.begin(), starts.end(), pos) - starts.begin() - 1;
+      }
+
+      /**
+       * @brief   sequence of record k as characters; a single record is unpacked once and
+       *          shared by all callers, other records are unpacked into buffer
+       **/
+      const std::string& record(int k, std::string &buffer) const
+      {
+        if (size() == 1)
+        {
+          std::call_once(unpacked_once, [this] { seq.unpack(0, seq.size(), unpacked); });
+          return unpacked;
+        }
+        seq.unpack(starts[k], lengths[k], buffer);
+        return buffer;
+      }
+  };
+}
+
+#endif
@@ -2,16 +2,46 @@
 #define COMMON_UTILS_HPP
 
 #include "kseq/kseq.h"
+#include "mummer/sparseSA.hpp"
 #include <fstream>
+#include <thread>
+#include "parallel.hpp"
 KSEQ_INIT(gzFile, gzread)
 
 namespace chainx
 {
+  //2-bit packed nucleotides, with residues other than ACGT in a side list
+  typedef mummer::mummer::packed_text PackedSequence;
 
   /**
-   * @brief   reads sequences from input fasta / fastq file
+   * @brief   copy len residues at src into dst in upper case, reusing capacity of dst
    **/
-  void readSequences(const std::string &path, std::vector<std::string> &seqs, std::vector<std::string> &ids)
+  inline void copyUpper(const char *src, std::size_t len, std::string &dst)
+  {
+    dst.resize(len);
+    for (std::size_t i = 0; i < len; i++)
+      dst[i] = ::toupper((unsigned char) src[i]);
+  }
+
+  /**
+   * @brief   store len residues at src into dst in upper case, as characters or packed
+   **/
+  inline void assignSequence(const char *src, std::size_t len, std::string &dst)
+  {
+    copyUpper(src, len, dst);
+  }
+
+  inline void assignSequence(const char *src, std::size_t len, PackedSequence &dst)
+  {
+    dst.clear();
+    dst.append(src, len);
+  }
+
+  /**
+   * @brief   reads sequences from input fasta / fastq file, as std::string or PackedSequence
+   **/
+  template <typename Seq>
+  void readSequences(const std::string &path, std::vector<Seq> &seqs, std::vector<std::string> &ids)
   {
     gzFile fp = gzopen(path.data(), "r");
 
@@ -27,14 +57,11 @@ namespace chainx
 
     while ((len = kseq_read(seq)) >= 0) 
     {
-      std::string str (seq->seq.s);
-      std::string name (seq->name.s);
+      seqs.emplace_back();
+      ids.emplace_back(seq->name.s, seq->name.l);
 
-      //convert to upper case
-      std::transform(str.begin(), str.end(), str.begin(), ::toupper);
-
-      seqs.push_back(str);
-      ids.push_back(name);
+      //convert to upper case while copying
+      assignSequence(seq->seq.s, seq->seq.l, seqs.back());
     }
 
     assert (seqs.size() > 0);
@@ -43,6 +70,164 @@ namespace chainx
     gzclose(fp); 
   }
 
+  const std::size_t BATCH_RECORDS = 4096;            //default maximum count of sequences in a batch
+  const std::size_t BATCH_RESIDUES = 64 << 20;       //default maximum residues in a batch
+
+  /**
+   * @brief   consecutive sequences of an input file, processed together
+   *          string buffers are kept across batches, only the first size() entries are valid
+   **/
+  struct SequenceBatch
+  {
+    std::vector<std::string> seqs;
+    std::vector<std::string> ids;
+    std::size_t first = 0;          //index of first sequence of batch in input file
+    std::size_t count = 0;          //count of sequences in batch
+    std::size_t residues = 0;       //total length of sequences in batch
+
+    std::size_t size() const { return count; }
+  };
+
+  /**
+   * @brief   streams sequences from input fasta / fastq file in batches of at most
+   *          maxRecords sequences or maxResidues residues (at least one sequence), so that
+   *          memory use does not grow with file size
+   **/
+  class SequenceReader
+  {
+    private:
+      gzFile fp;
+      kseq_t *seq;
+      std::size_t maxRecords, maxResidues;
+      std::size_t next_index = 0;
+
+    public:
+      SequenceReader(const std::string &path, std::size_t maxRecords = BATCH_RECORDS, std::size_t maxResidues = BATCH_RESIDUES)
+        : maxRecords(std::max<std::size_t>(1, maxRecords)), maxResidues(maxResidues)
+      {
+        fp = gzopen(path.data(), "r");
+
+        if (fp == NULL) {
+          fprintf(stderr, "gzopen failed to read input file\n");
+          exit(1);
+        }
+
+        seq = kseq_init(fp);
+      }
+
+      SequenceReader(const SequenceReader &) = delete;
+      SequenceReader& operator=(const SequenceReader &) = delete;
+
+      ~SequenceReader()
+      {
+        kseq_destroy(seq);
+        gzclose(fp);
+      }
+
+      /**
+       * @brief   refill batch with the next sequences, returns false at end of input
+       **/
+      bool next(SequenceBatch &batch)
+      {
+        batch.first = next_index;
+        batch.count = 0;
+        batch.residues = 0;
+
+        while (batch.count < maxRecords && (batch.count == 0 || batch.residues < maxResidues))
+        {
+          if (kseq_read(seq) < 0) break;
+
+          if (batch.count == batch.seqs.size())
+          {
+            batch.seqs.emplace_back();
+            batch.ids.emplace_back();
+          }
+
+          batch.ids[batch.count].assign(seq->name.s, seq->name.l);
+          copyUpper(seq->seq.s, seq->seq.l, batch.seqs[batch.count]);
+          batch.residues += seq->seq.l;
+          batch.count++;
+        }
+
+        next_index += batch.count;
+        return batch.count > 0;
+      }
+  };
+
+  /**
+   * @brief   SequenceReader running on its own thread, decompression and parsing of the
+   *          next batches overlap with processing of the current one
+   *          'depth' batches are in flight; a batch taken with next() must be handed back
+   *          with release() before its buffers are refilled
+   **/
+  class SequenceStream
+  {
+    private:
+      SequenceReader reader;
+      std::vector<SequenceBatch> batches;
+      BoundedQueue<SequenceBatch*> free_batches, filled_batches;
+      std::thread worker;
+
+    public:
+      SequenceStream(const std::string &path, std::size_t depth = 2)
+        : reader(path), batches(std::max<std::size_t>(depth, 1)), free_batches(batches.size()), filled_batches(batches.size())
+      {
+        for (auto &b : batches) free_batches.push(&b);
+
+        worker = std::thread([this]
+        {
+          SequenceBatch *b;
+          while (free_batches.pop(b))
+          {
+            if (!reader.next(*b)) break;
+            filled_batches.push(b);
+          }
+          filled_batches.close();
+        });
+      }
+
+      SequenceStream(const SequenceStream &) = delete;
+      SequenceStream& operator=(const SequenceStream &) = delete;
+
+      ~SequenceStream()
+      {
+        free_batches.close();
+        filled_batches.close();
+        worker.join();
+      }
+
+      /**
+       * @brief   next batch in file order, waits until it is parsed; NULL at end of input
+       **/
+      SequenceBatch* next()
+      {
+        SequenceBatch *b;
+        return filled_batches.pop(b) ? b : NULL;
+      }
+
+      void release(SequenceBatch *b) { free_batches.push(b); }
+  };
+
+  /**
+   * @brief   reverse complement of a DNA sequence, characters other than ACGT are kept
+   **/
+  inline void reverseComplement(const std::string &seq, std::string &rc)
+  {
+    rc.resize(seq.length());
+    for (std::size_t i = 0; i < seq.length(); i++)
+    {
+      char c = seq[seq.length() - 1 - i];
+      switch (c)
+      {
+        case 'A': c = 'T'; break;
+        case 'C': c = 'G'; break;
+        case 'G': c = 'C'; break;
+        case 'T': c = 'A'; break;
+      }
+      rc[i] = c;
+    }
+  }
+
   inline bool exists (const std::string& filename) {
   std::ifstream f(filename.c_str());
   return f.good();
@@ -6,6 +6,7 @@
 #include <zlib.h>  
 #include <string>
 #include <chrono>
+#include <memory>
 
 //third-party lib
 #include "mummer/sparseSA.hpp"
@@ -15,6 +16,9 @@
 //own includes
 #include "parseCmdArgs.hpp"
 #include "algo.hpp"
+#include "index.hpp"
+#include "target.hpp"
+#include "kmer_index.hpp"
 
 #undef VERBOSE
 #define VERBOSE 0
@@ -24,18 +28,17 @@ int main(int argc, char **argv)
   chainx::Parameters parameters;
   chainx::parseandSave_printanchors(argc, argv, parameters);
 
-  std::vector<std::string> queries; //one or multiple sequences
-  std::vector<std::string> query_ids;
-  std::vector<std::string> target; //single sequence
+  std::vector<chainx::PackedSequence> target; //one or multiple records
   std::vector<std::string> target_ids;
 
-  chainx::readSequences(parameters.qfile, queries, query_ids);
   chainx::readSequences(parameters.tfile, target, target_ids);
 
-  int queryLenSum = 0;
-  for (auto &q: queries) queryLenSum += q.length();
-  std::cerr << "INFO, printanchors::main, read " << queries.size() << " queries, " << queryLenSum << " residues\n";
-  if (!parameters.all2all) std::cerr << "INFO, printanchors::main, read target, " << target[0].length() << " residues\n";
+  //records are indexed together, same as chainX, so that its index files can be loaded
+  chainx::TargetSet targets (target, target_ids);
+  bool multi = targets.size() > 1;
+  std::cerr << "INFO, printanchors::main, read target, " << targets.residues() << " residues";
+  if (multi) std::cerr << " in " << targets.size() << " records";
+  std::cerr << "\n";
 
   //Start timer
   auto tStart = std::chrono::system_clock::now();
@@ -45,40 +48,83 @@ int main(int argc, char **argv)
   //lambda function
   auto append_matches = [&](const mummer::mummer::match_t& m) { fwd_matches.emplace_back(m.ref, m.query, m.len); }; //0-based coordinates
 
-  //Compute anchors
-  mummer::mummer::sparseSA sa (mummer::mummer::sparseSA::create_auto(target[0].data(), target[0].length(), parameters.minLen, true));
+  //Compute anchors, short targets of A, C, G and T are indexed by a hash table of k-mers instead of a suffix array
+  chainx::MappedFile index_file;   //backs the suffix array when loaded with -i
+  std::unique_ptr<mummer::mummer::sparseSA> sa;
+  std::unique_ptr<chainx::KmerIndex> kmers;
+  if (parameters.ifile.empty() && parameters.sparseness == 1 && targets.seq.size() <= (std::size_t) parameters.kmerIndexMax
+      && targets.nucleotides_only())
+    kmers.reset(new chainx::KmerIndex(targets.seq, parameters.minLen));
+  else
+    sa.reset(new mummer::mummer::sparseSA(parameters.ifile.empty() ?
+        mummer::mummer::sparseSA::create_auto(targets.seq, parameters.minLen, true, parameters.sparseness) :
+        chainx::load_index(parameters.ifile, targets.seq, parameters.minLen, parameters.sparseness, index_file)));
 
   std::chrono::duration<double> wctduration = (std::chrono::system_clock::now() - tStart);
-  std::cerr << "INFO, printanchors::main, suffix array computed in " << wctduration.count() << " seconds\n";
+  if (kmers)
+  {
+    std::cerr << "INFO, printanchors::main, k-mer index computed in " << wctduration.count() << " seconds\n";
+    std::cerr << "INFO, printanchors::main, k-mer index size = " << kmers->index_size_in_bytes() << " bytes\n";
+  }
+  else
+  {
+    std::cerr << "INFO, printanchors::main, suffix array " << (parameters.ifile.empty() ? "computed" : "loaded") << " in " << wctduration.count() << " seconds\n";
+    std::cerr << "INFO, printanchors::main, suffix array sparseness = " << sa->K << ", size = " << sa->index_size_in_bytes() << " bytes\n";
+  }
+
+  //queries are streamed in batches
+  chainx::SequenceReader reader (parameters.qfile);
+  chainx::SequenceBatch batch;
+  std::size_t queryCount = 0, queryLenSum = 0;
 
-  for (int i = 0; i < queries.size(); i++)
+  while (reader.next(batch))
   {
-    std::cerr << "\nINFO, printanchors::main, timer reset\n";
-    tStart = std::chrono::system_clock::now();
-    fwd_matches.clear();
-    if (parameters.matchType == "MEM")
-      sa.findMEM_each(queries[i].data(), queries[i].length(), parameters.minLen, false, append_matches);
-    else if (parameters.matchType == "MUM")
-      sa.findMUM_each(queries[i].data(), queries[i].length(), parameters.minLen, false, append_matches);
-    else
-      std::cerr << "ERROR, printanchors::main, incorrect anchor type specified" << "\n";
-
-    wctduration = (std::chrono::system_clock::now() - tStart);
-    std::cerr << "INFO, printanchors::main, anchor computation finished (" << wctduration.count() << " seconds elapsed)\n";
-    std::cerr << "INFO, printanchors::main, printing anchor coorindates (1-based) to stdout\n";
-    std::cerr << "INFO, printanchors::main, format: <qry_id> <qry_st> <qry_end> <target_st> <target_end> <length>\n";
-
-    //print 1-based coordinates
-    for (auto &e:fwd_matches)
+    const std::vector<std::string> &queries = batch.seqs;
+
+    for (std::size_t i = 0; i < batch.size(); i++)
     {
-      std::cout << i << "\t" \
-        << std::get<1>(e)+1 << "\t" \
-        << std::get<1>(e) + std::get<2>(e) << "\t" \
-        << std::get<0>(e)+1 << "\t" \
-        << std::get<0>(e) + std::get<2>(e) << "\t" \
-        << std::get<2>(e) << "\n";
+      std::cerr << "\nINFO, printanchors::main, timer reset\n";
+      tStart = std::chrono::system_clock::now();
+      fwd_matches.clear();
+      if (parameters.matchType == "MEM")
+      {
+        if (kmers) kmers->findMEM_each(queries[i].data(), queries[i].length(), parameters.minLen, false, append_matches);
+        else sa->findMEM_each(queries[i].data(), queries[i].length(), parameters.minLen, false, append_matches);
+      }
+      else if (parameters.matchType == "MUM")
+      {
+        if (kmers) kmers->findMUM_each(queries[i].data(), queries[i].length(), parameters.minLen, false, append_matches);
+        else sa->findMUM_each(queries[i].data(), queries[i].length(), parameters.minLen, false, append_matches);
+      }
+      else
+        std::cerr << "ERROR, printanchors::main, incorrect anchor type specified" << "\n";
+
+      wctduration = (std::chrono::system_clock::now() - tStart);
+      std::cerr << "INFO, printanchors::main, anchor computation finished (" << wctduration.count() << " seconds elapsed)\n";
+      std::cerr << "INFO, printanchors::main, printing anchor coorindates (1-based) to stdout\n";
+      std::cerr << "INFO, printanchors::main, format: <qry_id> <qry_st> <qry_end> <target_st> <target_end> <length>" << (multi ? " <target_id>" : "") << "\n";
+
+      //print 1-based coordinates, relative to the target record
+      for (auto &e:fwd_matches)
+      {
+        int r = multi ? targets.locate(std::get<0>(e)) : 0;
+        int ref = std::get<0>(e) - targets.starts[r];
+        std::cout << batch.first + i << "\t" \
+          << std::get<1>(e)+1 << "\t" \
+          << std::get<1>(e) + std::get<2>(e) << "\t" \
+          << ref+1 << "\t" \
+          << ref + std::get<2>(e) << "\t" \
+          << std::get<2>(e);
+        if (multi) std::cout << "\t" << targets.ids[r];
+        std::cout << "\n";
+      }
     }
+
+    queryCount += batch.size();
+    queryLenSum += batch.residues;
   }
 
+  std::cerr << "\nINFO, printanchors::main, processed " << queryCount << " queries, " << queryLenSum << " residues\n";
+
   return 0;
 }